@@ -1,17 +1,11 @@
-#include <iostream>
+#include "kernel.h"
+
+using config_operations = type_list<std::plus<>, std::minus<>, std::divides<>>;
+constexpr const char* operation_names[] = { "+", "-", "/" };
 
 void foo()
-{ 
-	unsigned int x0 = 5, y0 = 5; 
-	std::cout << "(unsigned int) 5 + (unsigned int) 5 = " << x0 + y0 << "\n";
-	std::cout << "(unsigned int) 5 - (unsigned int) 5 = " << x0 - y0 << "\n";
-	std::cout << "(unsigned int) 5 / (unsigned int) 5 = " << x0 / y0 << "\n";
-	int x1 = 4, y1 = 4; 
-	std::cout << "(int) 4 + (int) 4 = " << x1 + y1 << "\n";
-	std::cout << "(int) 4 - (int) 4 = " << x1 - y1 << "\n";
-	std::cout << "(int) 4 / (int) 4 = " << x1 / y1 << "\n";
-	double x2 = 7.4, y2 = 7.4; 
-	std::cout << "(double) 7.4 + (double) 7.4 = " << x2 + y2 << "\n";
-	std::cout << "(double) 7.4 - (double) 7.4 = " << x2 - y2 << "\n";
-	std::cout << "(double) 7.4 / (double) 7.4 = " << x2 / y2 << "\n";
-}
\ No newline at end of file
+{
+	run_type<unsigned int>("unsigned int", "5", static_cast<unsigned int>(5), operation_names, config_operations{}, std::make_index_sequence<3>{});
+	run_type<int>("int", "4", static_cast<int>(4), operation_names, config_operations{}, std::make_index_sequence<3>{});
+	run_type<double>("double", "7.4", static_cast<double>(7.4), operation_names, config_operations{}, std::make_index_sequence<3>{});
+}
@@ -0,0 +1,71 @@
+#pragma once
+// Ядра, общие для сгенерированной foo.cpp и режима --run: операция применяется к массивам
+// блоками по kernel_unroll независимых элементов, развёрнутыми на этапе компиляции, чтобы
+// компилятор мог векторизовать цикл, и для каждой пары (тип, операция) печатается результат
+// и замер пропускной способности. Перебор операций конфига для типа в foo.cpp раскрывается
+// fold-выражением, так что каждая комбинация - отдельная специализация без ветвлений.
+#include <iostream>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+
+template <typename... Ts>
+struct type_list {};
+
+constexpr std::size_t kernel_unroll = 8;
+constexpr std::size_t kernel_size = 1 << 16;
+constexpr int kernel_repeats = 200;
+
+template <typename T, typename Op, std::size_t... I>
+inline void kernel_block(const T* a, const T* b, T* out, Op op, std::index_sequence<I...>)
+{
+	((out[I] = static_cast<T>(op(a[I], b[I]))), ...);
+}
+
+template <typename T, typename Op>
+void kernel(const T* __restrict a, const T* __restrict b, T* __restrict out, std::size_t n, Op op)
+{
+	const std::size_t blocks = n - n % kernel_unroll;
+	std::size_t i = 0;
+	for (; i < blocks; i += kernel_unroll)
+		kernel_block(a + i, b + i, out + i, op, std::make_index_sequence<kernel_unroll>{});
+	for (; i < n; i++)
+		out[i] = static_cast<T>(op(a[i], b[i]));
+}
+
+template <typename T, typename Op>
+void benchmark(const char* type_name, const char* op_name, const char* initial_text, T initial)
+{
+	std::cout << "(" << type_name << ") " << initial_text << " " << op_name
+		<< " (" << type_name << ") " << initial_text << " = ";
+	if (std::is_integral<T>::value && std::is_same<Op, std::divides<>>::value && initial == 0)
+	{
+		std::cout << "division by zero\n";
+		return;
+	}
+	std::cout << Op{}(initial, initial);
+
+	std::unique_ptr<T[]> a(new T[kernel_size]), b(new T[kernel_size]), out(new T[kernel_size]());
+	for (std::size_t i = 0; i < kernel_size; i++)
+		a[i] = b[i] = initial;
+	volatile T sink{};
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < kernel_repeats; r++)
+	{
+		kernel(a.get(), b.get(), out.get(), kernel_size, Op{});
+		sink = out[r % kernel_size];
+	}
+	static_cast<void>(sink);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "\t[" << kernel_size * kernel_repeats / seconds / 1e6 << " Mop/s]\n";
+}
+
+template <typename T, typename... Ops, std::size_t... I>
+void run_type(const char* type_name, const char* initial_text, T initial, const char* const* op_names,
+							type_list<Ops...>, std::index_sequence<I...>)
+{
+	(benchmark<T, Ops>(type_name, op_names[I], initial_text, initial), ...);
+}
@@ -2,19 +2,140 @@
 #include <fstream>
 #include <vector>
 #include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <sstream>
+#include <type_traits>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
+#include "kernel.h"
 
 
 std::unordered_set<std::string> types{ "char", "bool", "double", "int", "long", "short", "float" };
 std::unordered_set<std::string> operations{ "/", "*", "+", "-" };
 
+// Функторы, которыми операции конфига подставляются в шаблонные ядра foo.cpp
+const std::unordered_map<std::string, std::string> operation_functors{
+	{ "+", "std::plus<>" },
+	{ "-", "std::minus<>" },
+	{ "*", "std::multiplies<>" },
+	{ "/", "std::divides<>" },
+};
+
+
+// Значение литерала из конфига так, как его понял бы компилятор в сгенерированном
+// "type x = literal": целый или вещественный литерал приводится к типу переменной
+template <typename T>
+bool parse_value(const std::string& literal, T& value)
+{
+	if (literal == "true" || literal == "false")
+	{
+		value = static_cast<T>(literal == "true");
+		return true;
+	}
+	if (literal.size() == 3 && literal.front() == '\'' && literal.back() == '\'')
+	{
+		value = static_cast<T>(literal[1]);
+		return true;
+	}
+
+	std::istringstream stream(literal);
+	if (literal.find_first_of(".eE") != std::string::npos)
+	{
+		long double parsed;
+		stream >> parsed;
+		value = static_cast<T>(parsed);
+	}
+	else
+	{
+		long long parsed;
+		stream >> parsed;
+		value = static_cast<T>(parsed);
+	}
+	return stream && stream.peek() == EOF;
+}
+
+// Выполняет операции для одного типа теми же ядрами из kernel.h, что и сгенерированная
+// foo(), поэтому печатает то же самое, включая замер пропускной способности
+template <typename T>
+bool run_operations(const std::string& type, const std::string& initial_value, const std::vector<std::string>& user_operations)
+{
+	T x;
+	if (!parse_value(initial_value, x))
+	{
+		std::cout << initial_value + " is invalid initial value for " + type + "\n";
+		return false;
+	}
+
+	for (auto& op : user_operations)
+	{
+		if (op == "+")
+			benchmark<T, std::plus<>>(type.c_str(), op.c_str(), initial_value.c_str(), x);
+		else if (op == "-")
+			benchmark<T, std::minus<>>(type.c_str(), op.c_str(), initial_value.c_str(), x);
+		else if (op == "*")
+			benchmark<T, std::multiplies<>>(type.c_str(), op.c_str(), initial_value.c_str(), x);
+		else
+			benchmark<T, std::divides<>>(type.c_str(), op.c_str(), initial_value.c_str(), x);
+	}
+	return true;
+}
+
+using operations_runner = std::function<bool(const std::string&, const std::string&, const std::vector<std::string>&)>;
+
+// Все типы, которые допускает конфиг, включая сочетания с signed/unsigned
+const std::unordered_map<std::string, operations_runner> runners{
+	{ "char", run_operations<char> },
+	{ "signed char", run_operations<signed char> },
+	{ "unsigned char", run_operations<unsigned char> },
+	{ "bool", run_operations<bool> },
+	{ "short", run_operations<short> },
+	{ "signed short", run_operations<short> },
+	{ "unsigned short", run_operations<unsigned short> },
+	{ "int", run_operations<int> },
+	{ "signed int", run_operations<int> },
+	{ "unsigned int", run_operations<unsigned int> },
+	{ "signed", run_operations<int> },
+	{ "unsigned", run_operations<unsigned int> },
+	{ "long", run_operations<long> },
+	{ "signed long", run_operations<long> },
+	{ "unsigned long", run_operations<unsigned long> },
+	{ "float", run_operations<float> },
+	{ "double", run_operations<double> },
+};
+
+// Выполнение конфига без генерации и компиляции foo.cpp
+int run_in_process(const std::vector<std::string>& user_types, const std::vector<std::string>& user_operations,
+									 const std::vector<std::string>& user_initial_val)
+{
+	for (size_t i = 0; i < user_types.size(); i++)
+	{
+		auto runner = runners.find(user_types[i]);
+		if (runner == runners.end())
+		{
+			std::cout << user_types[i] + " is invalid type, please try again\n";
+			return -1;
+		}
+		if (!runner->second(user_types[i], user_initial_val[i], user_operations))
+			return -1;
+	}
+	return 0;
+}
+
 
 int main(int argc, char** argv)
 {
+	// Использование: main [config.txt] [--run]
+	// С --run конфиг выполняется сразу в этом процессе вместо генерации foo.cpp
 	std::string config_file = "config.txt";
-	if (argc >= 2)
-		config_file = argv[1];
+	bool run_mode = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--run")
+			run_mode = true;
+		else
+			config_file = argv[i];
+	}
 
 	std::string user_types_str;
 	std::vector<std::string> user_types;
@@ -97,29 +218,34 @@ int main(int argc, char** argv)
 		std::cout << "Not enough initial values!\n";
 		return -1;
 	}
-		
+
+	if (run_mode)
+		return run_in_process(user_types, user_operations, user_initial_val);
+
 
 	std::ofstream output_file("foo.cpp");
 
-	int counter = 0;
-	output_file << "#include <iostream>\n\n";
-	output_file << "void foo()\n{ \n";
-	for (auto& type : user_types)
-	{
+	output_file << "#include \"kernel.h\"\n\n";
 
+	output_file << "using config_operations = type_list<";
+	for (size_t i = 0; i < user_operations.size(); i++)
+		output_file << (i ? ", " : "") << operation_functors.at(user_operations[i]);
+	output_file << ">;\n";
 
-		output_file << "\t" + type + " x" + std::to_string(counter) + " = " + user_initial_val[counter] +
-									", y" + std::to_string(counter) + " = " + user_initial_val[counter] + "; \n";
-		for (auto& op : user_operations)
-		{
-			output_file << "\tstd::cout << \"(" + type + ") " + user_initial_val[counter] + " " + op
-										 + " (" + type + ") " + user_initial_val[counter] + " = \" ";
-			output_file << "<< x" + std::to_string(counter) + " " + op + " y" + std::to_string(counter) + " << \"\\n\";";
-			output_file << "\n";
-		}
-		counter++;
+	output_file << "constexpr const char* operation_names[] = { ";
+	for (size_t i = 0; i < user_operations.size(); i++)
+		output_file << (i ? ", " : "") << "\"" << user_operations[i] << "\"";
+	output_file << " };\n\n";
+
+	output_file << "void foo()\n{\n";
+	for (size_t i = 0; i < user_types.size(); i++)
+	{
+		const std::string& type = user_types[i];
+		output_file << "\trun_type<" << type << ">(\"" << type << "\", \"" << user_initial_val[i] << "\", static_cast<"
+								<< type << ">(" << user_initial_val[i] << "), operation_names, config_operations{}, "
+								<< "std::make_index_sequence<" << user_operations.size() << ">{});\n";
 	}
-	output_file << "}";
+	output_file << "}\n";
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -4,7 +4,25 @@
 #include <list>
 
 
-template <typename T>
+// Трассировка вызовов выбирается на этапе компиляции: в release-сборке (NDEBUG)
+// используется пустая политика, и вызовы Trace::event не порождают кода
+struct NoTrace {
+    static void event(const char*) {}
+};
+
+struct LogTrace {
+    static void event(const char* name) {
+        std::cout << name << std::endl;
+    }
+};
+
+#ifdef NDEBUG
+using DefaultTrace = NoTrace;
+#else
+using DefaultTrace = LogTrace;
+#endif
+
+template <typename T, typename Trace = DefaultTrace>
 class BinaryTree {
 private:
     struct Node {
@@ -76,31 +94,31 @@ private:
 public:
     BinaryTree() : root(nullptr) {}
 
-    bool operator<(const BinaryTree<T>& another) const {
+    bool operator<(const BinaryTree& another) const {
         return (this->root ? this->root->size : 0) < (another.root ? another.root->size : 0);
     }
 
-    bool operator>(const BinaryTree<T>& another) const {
+    bool operator>(const BinaryTree& another) const {
         return (this->root ? this->root->size : 0) > (another.root ? another.root->size : 0);
     }
 
-    bool operator==(const BinaryTree<T>& another) const {
+    bool operator==(const BinaryTree& another) const {
         return (this->root ? this->root->size : 0) == (another.root ? another.root->size : 0);
     }
 
 
     BinaryTree(const BinaryTree& other) {
-        std::cout << "Copy Constructor" << std::endl;
+        Trace::event("Copy Constructor");
         root = copy(other.root);
     }
 
     BinaryTree(BinaryTree&& other) noexcept : root(other.root) {
-        std::cout << "Move Constructor" << std::endl;
+        Trace::event("Move Constructor");
         other.root = nullptr; 
     }
 
     BinaryTree& operator=(const BinaryTree& other) {
-        std::cout << "Assignment Operator" << std::endl;
+        Trace::event("Assignment Operator");
         if (this != &other) {
             clear(root);
             root = copy(other.root);
@@ -109,7 +127,7 @@ public:
     }
 
     BinaryTree& operator=(BinaryTree&& other) noexcept {
-        std::cout << "Move Assignment Operator" << std::endl;
+        Trace::event("Move Assignment Operator");
         if (this != &other) {
             clear(root); 
             root = other.root; 
@@ -119,17 +137,17 @@ public:
     }
 
     void insert(T value) {
-        std::cout << "insert" << std::endl;
+        Trace::event("insert");
         insert(root, value);
     }
 
     bool search(T value) {
-        std::cout << "search" << std::endl;
+        Trace::event("search");
         return search(root, value);
     }
 
     void inOrder() {
-        std::cout << "inOrder" << std::endl;
+        Trace::event("inOrder");
         inOrder(root);
         std::cout << std::endl; 
     }
@@ -148,7 +166,7 @@ public:
     }
 
     ~BinaryTree() {
-        std::cout << "Destructor" << std::endl;
+        Trace::event("Destructor");
         clear(root);
     }
 };
@@ -3,229 +3,2963 @@
 
 #include <iostream>
 #include <vector>
-#include <list>
 #include <algorithm>
+#include <functional>
 #include <unordered_set>
+#include <iterator>
+#include <future>
+#include <thread>
+#include <cstdint>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <type_traits>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+#include <map>
+#include <iomanip>
+#include <sstream>
+#include <numeric>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BINARYTREE_SSE2 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BINARYTREE_PREFETCH(address) __builtin_prefetch(address)
+#elif defined(BINARYTREE_SSE2)
+#include <xmmintrin.h>
+#define BINARYTREE_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#else
+#define BINARYTREE_PREFETCH(address) ((void)0)
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BINARYTREE_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define BINARYTREE_NOINLINE __declspec(noinline)
+#else
+#define BINARYTREE_NOINLINE
+#endif
+
+// Политики трассировки BinaryTree выбираются на этапе компиляции.
+// Все хуки статические, а в NoTrace пустые, поэтому в release-сборке от них не остаётся кода.
+struct NoTrace {
+	static void event(const char*) {}
+	static void nodeAllocated() {}
+	static void nodeInserted(int) {}
+	static void searchFinished(int) {}
+	static void copied() {}
+	static void moved() {}
+};
+
+// Печать имени каждого вызванного метода в std::cout
+struct LogTrace : NoTrace {
+	static void event(const char* name) {
+		std::cout << name << std::endl;
+	}
+};
+
+// Снимок счётчиков CountingTrace
+struct TreeStatsSnapshot {
+	static constexpr int maxDepth = 64;
+
+	uint64_t nodeAllocations = 0;
+	uint64_t searches = 0;
+	uint64_t searchComparisons = 0;
+	uint64_t copies = 0;
+	uint64_t moves = 0;
+	// depthHistogram[d] - сколько узлов было создано на глубине d (последняя ячейка - d >= maxDepth - 1)
+	// вставкой, переводом массива small в узлы или построением из отсортированных значений.
+	// insertSorted перестраивает дерево целиком и учитывает все его узлы заново; узлы, которые
+	// пересобирают операции над множествами и split/join, не учитываются
+	std::array<uint64_t, maxDepth> depthHistogram{};
+
+	double comparisonsPerSearch() const {
+		return searches ? static_cast<double>(searchComparisons) / searches : 0.0;
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const TreeStatsSnapshot& stats) {
+		os << "node allocations: " << stats.nodeAllocations << "\n"
+			<< "searches: " << stats.searches << ", comparisons per search: " << stats.comparisonsPerSearch() << "\n"
+			<< "copies: " << stats.copies << ", moves: " << stats.moves << "\n"
+			<< "insert depth histogram:";
+		for (int depth = 0; depth < maxDepth; ++depth) {
+			if (stats.depthHistogram[depth] != 0) {
+				os << " " << depth << ":" << stats.depthHistogram[depth];
+			}
+		}
+		return os << "\n";
+	}
+};
+
+// Счётчики горячих путей, общие для всех деревьев с этой политикой
+struct CountingTrace : NoTrace {
+	static void nodeAllocated() {
+		counters().nodeAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	static void nodeInserted(int depth) {
+		int bucket = std::min(depth, TreeStatsSnapshot::maxDepth - 1);
+		counters().depthHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+	static void searchFinished(int comparisons) {
+		counters().searches.fetch_add(1, std::memory_order_relaxed);
+		counters().searchComparisons.fetch_add(comparisons, std::memory_order_relaxed);
+	}
+	static void copied() {
+		counters().copies.fetch_add(1, std::memory_order_relaxed);
+	}
+	static void moved() {
+		counters().moves.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static TreeStatsSnapshot snapshot() {
+		const Counters& c = counters();
+		TreeStatsSnapshot stats;
+		stats.nodeAllocations = c.nodeAllocations.load(std::memory_order_relaxed);
+		stats.searches = c.searches.load(std::memory_order_relaxed);
+		stats.searchComparisons = c.searchComparisons.load(std::memory_order_relaxed);
+		stats.copies = c.copies.load(std::memory_order_relaxed);
+		stats.moves = c.moves.load(std::memory_order_relaxed);
+		for (int depth = 0; depth < TreeStatsSnapshot::maxDepth; ++depth) {
+			stats.depthHistogram[depth] = c.depthHistogram[depth].load(std::memory_order_relaxed);
+		}
+		return stats;
+	}
+
+	static void reset() {
+		Counters& c = counters();
+		c.nodeAllocations = 0;
+		c.searches = 0;
+		c.searchComparisons = 0;
+		c.copies = 0;
+		c.moves = 0;
+		for (auto& bucket : c.depthHistogram) {
+			bucket = 0;
+		}
+	}
+
+private:
+	struct Counters {
+		std::atomic<uint64_t> nodeAllocations{ 0 };
+		std::atomic<uint64_t> searches{ 0 };
+		std::atomic<uint64_t> searchComparisons{ 0 };
+		std::atomic<uint64_t> copies{ 0 };
+		std::atomic<uint64_t> moves{ 0 };
+		std::array<std::atomic<uint64_t>, TreeStatsSnapshot::maxDepth> depthHistogram{};
+	};
+
+	static Counters& counters() {
+		static Counters instance;
+		return instance;
+	}
+};
+
+// Есть ли у типа std::hash: от этого зависит, поддерживает ли дерево хеш содержимого
+template <typename T, typename = void>
+struct isHashable : std::false_type {};
 
 template <typename T>
+struct isHashable<T, std::void_t<decltype(std::hash<T>()(std::declval<const T&>()))>> : std::true_type {};
+
+template <typename K, typename V, typename Compare, typename Trace>
+class BinaryMap;
+
+// Compare задаёт строгий слабый порядок значений. Как и std::hash, он создаётся заново
+// при каждом сравнении, поэтому должен быть без состояния. С прозрачным компаратором
+// (например, std::less<>) find принимает любой тип, сравнимый с T, без создания временного T.
+// Хеш и operator== дерева по-прежнему опираются на std::hash<T> и operator== значений.
+template <typename T, typename Compare = std::less<T>, typename Trace = NoTrace>
 class BinaryTree {
 private:
+	template <typename K, typename V, typename MapCompare, typename MapTrace>
+	friend class BinaryMap;
+
 	struct Node {
 		T data;
 		Node* left;
 		Node* right;
 		int size = 1;
+		// Сумма хешей значений поддерева, чтобы хеш результата операций над множествами
+		// получался за O(1), как и размер
+		size_t hashSum = 0;
+		// Число деревьев и родительских узлов, ссылающихся на узел. Узлы с refs > 1
+		// разделяются между копиями и перед изменением копируются (copy-on-write)
+		std::atomic<int> refs{ 1 };
 
-		Node(T value) : data(value), left(nullptr), right(nullptr) {}
+		template <typename... Args>
+		explicit Node(Args&&... args) : data(std::forward<Args>(args)...), left(nullptr), right(nullptr) {}
 	};
 
+	// Небольшие деревья хранят значения прямо в объекте отсортированным массивом и
+	// переходят на узлы, только когда массив заполнен. Инвариант: при root == nullptr
+	// содержимое дерева - это small[0..smallCount). Для типов, которые дорого копировать,
+	// smallCapacity равна 0 и дерево всегда узловое.
+	static constexpr int smallCapacity = (std::is_trivially_copyable<T>::value && sizeof(T) <= 8) ? 64 / sizeof(T) : 0;
+
 	Node* root;
-	bool debug = false;
+	std::array<T, smallCapacity> small{};
+	int smallCount = 0;
+	// Хеш содержимого: сумма перемешанных хешей значений, поэтому он не зависит
+	// от формы дерева и порядка вставки и обновляется за O(1) на каждый insert
+	size_t hashValue = 0;
+
+	template <typename... Args>
+	static Node* allocateNode(Args&&... args) {
+		Trace::nodeAllocated();
+		Node* node = new Node(std::forward<Args>(args)...);
+		node->hashSum = elementHash(node->data);
+		return node;
+	}
+
+	template <typename A, typename B>
+	static bool precedes(const A& a, const B& b) {
+		return Compare()(a, b);
+	}
+
+	// Эквивалентность в смысле Compare: ни одно значение не предшествует другому
+	template <typename A, typename B>
+	static bool equivalent(const A& a, const B& b) {
+		return !precedes(a, b) && !precedes(b, a);
+	}
+
+	static int sizeOf(const Node* node) {
+		return node ? node->size : 0;
+	}
+
+	static size_t hashOf(const Node* node) {
+		return node ? node->hashSum : 0;
+	}
+
+	// Пересчёт размера и хеша узла по его детям
+	static void update(Node* node) {
+		node->size = sizeOf(node->left) + sizeOf(node->right) + 1;
+		node->hashSum = hashOf(node->left) + hashOf(node->right) + elementHash(node->data);
+	}
+
+	static size_t elementHash(const T& value) {
+		if constexpr (isHashable<T>::value) {
+			// Финализатор splitmix64: без него сумма хешей соседних int почти не перемешивается
+			uint64_t x = static_cast<uint64_t>(std::hash<T>()(value)) + 0x9e3779b97f4a7c15ULL;
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+			return static_cast<size_t>(x ^ (x >> 31));
+		}
+		else {
+			static_cast<void>(value);
+			return 0; // Без std::hash<T> хеш содержимого не поддерживается
+		}
+	}
+
+	template <typename It>
+	static size_t hashRange(It first, It last) {
+		size_t sum = 0;
+		for (; first != last; ++first) {
+			sum += elementHash(*first);
+		}
+		return sum;
+	}
+
+	// Поэлементное сравнение двух деревьев в порядке in-order без копирования значений
+	static bool equalValues(Node* a, Node* b) {
+		std::vector<Node*> stackA;
+		std::vector<Node*> stackB;
+		while (true) {
+			while (a != nullptr) {
+				stackA.push_back(a);
+				a = a->left;
+			}
+			while (b != nullptr) {
+				stackB.push_back(b);
+				b = b->left;
+			}
+			if (stackA.empty() || stackB.empty()) {
+				return stackA.empty() && stackB.empty();
+			}
+			a = stackA.back();
+			b = stackB.back();
+			stackA.pop_back();
+			stackB.pop_back();
+			if (!(a->data == b->data)) {
+				return false;
+			}
+			a = a->right;
+			b = b->right;
+		}
+	}
+
+	// Возвращает узел, который можно изменять: разделяемый узел заменяется своей копией,
+	// а его дети получают ещё одну ссылку. Так вставка копирует только путь от корня
+	static Node* detach(Node* node) {
+		if (node->refs.load(std::memory_order_acquire) == 1) {
+			return node;
+		}
+		Node* newNode = allocateNode(node->data);
+		newNode->left = copy(node->left);
+		newNode->right = copy(node->right);
+		newNode->size = node->size;
+		newNode->hashSum = node->hashSum;
+		clear(node);
+		return newNode;
+	}
+
+	template <typename K>
+	const T* smallFind(const K& key) const {
+#ifdef BINARYTREE_SSE2
+		if constexpr (std::is_same<T, int>::value && std::is_same<K, int>::value && smallCapacity % 4 == 0
+			&& (std::is_same<Compare, std::less<int>>::value || std::is_same<Compare, std::less<>>::value)) {
+			// По четыре сравнения за инструкцию; лишние ячейки за smallCount отсекаются маской
+			__m128i needle = _mm_set1_epi32(key);
+			for (int i = 0; i < smallCount; i += 4) {
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(small.data() + i));
+				int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, needle)));
+				int valid = smallCount - i;
+				if (valid < 4) {
+					mask &= (1 << valid) - 1;
+				}
+				for (int lane = 0; lane < 4; ++lane) {
+					if (mask & (1 << lane)) {
+						return small.data() + i + lane;
+					}
+				}
+			}
+			return nullptr;
+		}
+#endif
+		auto position = std::lower_bound(small.begin(), small.begin() + smallCount, key, Compare());
+		return position != small.begin() + smallCount && !precedes(key, *position) ? &*position : nullptr;
+	}
+
+	// Перевод массива small в узлы, когда в нём не осталось места
+	void promote() {
+		const T* it = small.data();
+		root = buildBalanced(it, static_cast<size_t>(smallCount));
+		smallCount = 0;
+		traceBuilt(root);
+	}
+
+	// Сообщает Trace глубину каждого узла дерева, построенного целиком; для NoTrace обхода нет
+	static void traceBuilt(const Node* node, int depth = 0) {
+		if constexpr (!std::is_same<Trace, NoTrace>::value) {
+			if (node != nullptr) {
+				Trace::nodeInserted(depth);
+				traceBuilt(node->left, depth + 1);
+				traceBuilt(node->right, depth + 1);
+			}
+		}
+		else {
+			static_cast<void>(node);
+			static_cast<void>(depth);
+		}
+	}
+
+	// Заполняет дерево отсортированными значениями: массивом, если они помещаются, иначе узлами
+	template <typename It>
+	void assignSorted(It first, size_t n) {
+		if (n <= static_cast<size_t>(smallCapacity)) {
+			for (size_t i = 0; i < n; ++i, ++first) {
+				small[i] = *first;
+			}
+			smallCount = static_cast<int>(n);
+		}
+		else {
+			root = buildBalanced(first, n);
+			traceBuilt(root);
+		}
+	}
+
+	// Вставка готового узла спуском без рекурсии; разделяемые узлы пути копируются (detach).
+	// Значение не копируется ни на одном уровне: сравнения идут с fresh->data
+	void insertNode(Node* fresh) {
+		size_t valueHash = fresh->hashSum;
+		Node** link = &root;
+		int depth = 0;
+		while (*link != nullptr) {
+			Node* node = detach(*link);
+			*link = node;
+			node->size++;
+			node->hashSum += valueHash;
+			link = precedes(fresh->data, node->data) ? &node->left : &node->right;
+			++depth;
+		}
+		*link = fresh;
+		Trace::nodeInserted(depth);
+	}
+
+	// Значение, эквивалентное key, или nullptr
+	template <typename K>
+	const T* lookup(const K& key) const {
+		if (root == nullptr) {
+			const T* found = smallFind(key);
+			Trace::searchFinished(smallCount);
+			return found;
+		}
+		int comparisons = 0;
+		const Node* node = root;
+		while (node != nullptr) {
+			++comparisons;
+			if (precedes(key, node->data)) {
+				node = node->left;
+			}
+			else if (precedes(node->data, key)) {
+				node = node->right;
+			}
+			else {
+				Trace::searchFinished(comparisons);
+				return &node->data;
+			}
+		}
+		Trace::searchFinished(comparisons);
+		return nullptr;
+	}
+
+	// Изменяемый доступ к значению для BinaryMap: путь к узлу копируется, как при вставке,
+	// чтобы изменение не затронуло деревья, разделяющие с этим узлы. Допустим только для
+	// значений без std::hash, иначе изменение разошлось бы с hashSum узлов
+	template <typename K>
+	T* findForUpdate(const K& key) {
+		static_assert(!isHashable<T>::value, "Values of hashable trees must not be modified in place");
+		if (lookup(key) == nullptr) {
+			return nullptr;
+		}
+		if (root == nullptr) {
+			return const_cast<T*>(smallFind(key));
+		}
+		Node** link = &root;
+		while (true) {
+			Node* node = detach(*link);
+			*link = node;
+			if (precedes(key, node->data)) {
+				link = &node->left;
+			}
+			else if (precedes(node->data, key)) {
+				link = &node->right;
+			}
+			else {
+				return &node->data;
+			}
+		}
+	}
+
+	// Снимает одну ссылку с узла; поддерево удаляется, когда ссылок не остаётся
+	// Рекурсия идёт только в меньшее поддерево, большее освобождается в цикле, поэтому глубина
+	// стека не превышает log2(n) и у выродившегося в список дерева; памяти обход не выделяет
+	static void clear(Node* node) {
+		while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			Node* smaller = node->left;
+			Node* larger = node->right;
+			if (sizeOf(smaller) > sizeOf(larger)) {
+				std::swap(smaller, larger);
+			}
+			delete node;
+			clear(smaller);
+			node = larger;
+		}
+	}
+
+	// Обход в порядке возрастания с явным стеком вместо рекурсии глубиной в высоту дерева
+	template <typename Visit>
+	static void forEachInOrder(const Node* node, Visit&& visit) {
+		std::vector<const Node*> path;
+		while (node != nullptr || !path.empty()) {
+			while (node != nullptr) {
+				path.push_back(node);
+				node = node->left;
+			}
+			node = path.back();
+			path.pop_back();
+			visit(node->data);
+			node = node->right;
+		}
+	}
+
+	// Копирование поддерева за O(1): узлы не дублируются, а разделяются
+	static Node* copy(Node* node) {
+		if (node != nullptr) {
+			node->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+		return node;
+	}
+
+	// Строит идеально сбалансированное дерево из n элементов отсортированной последовательности.
+	// Узлы создаются в порядке in-order, поэтому итератор проходится ровно один раз.
+	template <typename It>
+	static Node* buildBalanced(It& it, size_t n) {
+		if (n == 0) {
+			return nullptr;
+		}
+		size_t leftCount = n / 2;
+		Node* left = buildBalanced(it, leftCount);
+		Node* node = allocateNode(*it);
+		++it;
+		node->left = left;
+		node->right = buildBalanced(it, n - leftCount - 1);
+		update(node);
+		return node;
+	}
+
+	// Параллельная версия для массива: левое поддерево строится в отдельной задаче,
+	// пока глубина рекурсии не исчерпала depthBudget.
+	static Node* buildBalancedParallel(const T* first, size_t n, int depthBudget) {
+		if (n < parallelThreshold || depthBudget <= 0) {
+			return buildBalanced(first, n);
+		}
+		size_t leftCount = n / 2;
+		auto leftTask = std::async(std::launch::async, [=] {
+			return buildBalancedParallel(first, leftCount, depthBudget - 1);
+			});
+		Node* node = allocateNode(first[leftCount]);
+		node->right = buildBalancedParallel(first + leftCount + 1, n - leftCount - 1, depthBudget - 1);
+		node->left = leftTask.get();
+		update(node);
+		return node;
+	}
+
+	static int parallelDepthBudget() {
+		unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+		int depthBudget = 0;
+		while ((1u << depthBudget) < threads) {
+			depthBudget++;
+		}
+		return depthBudget;
+	}
+
+	// Операции над множествами построены на join (Blelloch, Ferizovic, Sun, "Just Join for
+	// Parallel Ordered Sets"): дерево поддерживается сбалансированным по весу (вес = size + 1),
+	// и union/intersection/difference выполняются за O(m log(n/m + 1)).
+	// Все функции ниже забирают переданные им ссылки на узлы и возвращают свою; разделяемые
+	// узлы не изменяются, а копируются, поэтому исходные деревья остаются нетронутыми.
+	static constexpr double weightAlpha = 0.29;
+
+	static bool balancedWeights(size_t a, size_t b) {
+		return weightAlpha * (a + b) <= a && weightAlpha * (a + b) <= b;
+	}
+
+	static bool heavier(const Node* a, const Node* b) {
+		size_t wa = sizeOf(a) + 1;
+		size_t wb = sizeOf(b) + 1;
+		return wa > wb && !balancedWeights(wa, wb);
+	}
+
+	// Разбирает узел на (левое поддерево, узел без детей, правое поддерево)
+	static void expose(Node* node, Node*& left, Node*& middle, Node*& right) {
+		if (node->refs.load(std::memory_order_acquire) == 1) {
+			left = node->left;
+			right = node->right;
+			node->left = nullptr;
+			node->right = nullptr;
+			middle = node;
+		}
+		else {
+			left = copy(node->left);
+			right = copy(node->right);
+			middle = allocateNode(node->data);
+			clear(node);
+		}
+	}
+
+	static Node* makeNode(Node* left, Node* middle, Node* right) {
+		middle->left = left;
+		middle->right = right;
+		update(middle);
+		return middle;
+	}
+
+	static Node* rotateLeft(Node* node) {
+		Node* pivot = detach(node->right);
+		node->right = pivot->left;
+		update(node);
+		pivot->left = node;
+		update(pivot);
+		return pivot;
+	}
+
+	static Node* rotateRight(Node* node) {
+		Node* pivot = detach(node->left);
+		node->left = pivot->right;
+		update(node);
+		pivot->right = node;
+		update(pivot);
+		return pivot;
+	}
+
+	// Спуск по правому краю более тяжёлого left до поддерева, сопоставимого по весу с right.
+	// Деревья, собранные обычным insert, могут быть несбалансированными: тогда спуск может
+	// проскочить нужный вес, и соединение продолжается с другой стороны через joinLeft
+	static Node* joinRight(Node* left, Node* middle, Node* right) {
+		if (balancedWeights(sizeOf(left) + 1, sizeOf(right) + 1)) {
+			return makeNode(left, middle, right);
+		}
+		if (heavier(right, left)) {
+			return joinLeft(left, middle, right);
+		}
+		Node* l;
+		Node* m;
+		Node* c;
+		expose(left, l, m, c);
+		Node* joined = joinRight(c, middle, right);
+		size_t wl = sizeOf(l) + 1;
+		if (balancedWeights(wl, sizeOf(joined) + 1)) {
+			return makeNode(l, m, joined);
+		}
+		size_t wjl = sizeOf(joined->left) + 1;
+		size_t wjr = sizeOf(joined->right) + 1;
+		if (joined->left == nullptr || (balancedWeights(wl, wjl) && balancedWeights(wl + wjl, wjr))) {
+			return rotateLeft(makeNode(l, m, joined));
+		}
+		return rotateLeft(makeNode(l, m, rotateRight(joined)));
+	}
+
+	static Node* joinLeft(Node* left, Node* middle, Node* right) {
+		if (balancedWeights(sizeOf(left) + 1, sizeOf(right) + 1)) {
+			return makeNode(left, middle, right);
+		}
+		if (heavier(left, right)) {
+			return joinRight(left, middle, right);
+		}
+		Node* c;
+		Node* m;
+		Node* r;
+		expose(right, c, m, r);
+		Node* joined = joinLeft(left, middle, c);
+		size_t wr = sizeOf(r) + 1;
+		if (balancedWeights(sizeOf(joined) + 1, wr)) {
+			return makeNode(joined, m, r);
+		}
+		size_t wjl = sizeOf(joined->left) + 1;
+		size_t wjr = sizeOf(joined->right) + 1;
+		if (joined->right == nullptr || (balancedWeights(wr, wjr) && balancedWeights(wr + wjr, wjl))) {
+			return rotateRight(makeNode(joined, m, r));
+		}
+		return rotateRight(makeNode(rotateLeft(joined), m, r));
+	}
+
+	// Соединяет деревья, все значения left не больше middle, а middle - не больше значений right
+	static Node* join(Node* left, Node* middle, Node* right) {
+		if (heavier(left, right)) {
+			return joinRight(left, middle, right);
+		}
+		if (heavier(right, left)) {
+			return joinLeft(left, middle, right);
+		}
+		return makeNode(left, middle, right);
+	}
+
+	static Node* splitLast(Node* node, Node*& last) {
+		Node* l;
+		Node* m;
+		Node* r;
+		expose(node, l, m, r);
+		if (r == nullptr) {
+			last = m;
+			return l;
+		}
+		Node* rest = splitLast(r, last);
+		return join(l, m, rest);
+	}
+
+	static Node* join2(Node* left, Node* right) {
+		if (left == nullptr) {
+			return right;
+		}
+		if (right == nullptr) {
+			return left;
+		}
+		Node* last;
+		Node* rest = splitLast(left, last);
+		return join(rest, last, right);
+	}
+
+	// Делит дерево на значения меньше key, равные key и больше key
+	static void split(Node* node, const T& key, Node*& less, Node*& equal, Node*& greater) {
+		if (node == nullptr) {
+			less = equal = greater = nullptr;
+			return;
+		}
+		Node* l;
+		Node* m;
+		Node* r;
+		expose(node, l, m, r);
+		if (precedes(key, m->data)) {
+			Node* rest;
+			split(l, key, less, equal, rest);
+			greater = join(rest, m, r);
+		}
+		else if (precedes(m->data, key)) {
+			Node* rest;
+			split(r, key, rest, equal, greater);
+			less = join(l, m, rest);
+		}
+		else {
+			// Копии key могут оказаться по обе стороны узла после поворотов
+			Node* leftEqual;
+			Node* rightEqual;
+			Node* empty;
+			split(l, key, less, leftEqual, empty);
+			clear(empty);
+			split(r, key, empty, rightEqual, greater);
+			clear(empty);
+			equal = join(leftEqual, m, rightEqual);
+		}
+	}
+
+	static Node* without(Node* node, const T& key) {
+		Node* less;
+		Node* equal;
+		Node* greater;
+		split(node, key, less, equal, greater);
+		clear(equal);
+		return join2(less, greater);
+	}
+
+	template <typename Callback>
+	static void rangeScan(const Node* node, const T& lo, const T& hi, Callback& callback) {
+		while (node != nullptr) {
+			if (precedes(node->data, lo)) {
+				node = node->right; // левое поддерево целиком меньше lo
+			}
+			else if (precedes(hi, node->data)) {
+				node = node->left; // правое поддерево целиком больше hi
+			}
+			else {
+				rangeScan(node->left, lo, hi, callback);
+				callback(node->data);
+				node = node->right;
+			}
+		}
+	}
+
+	// Состояние одной дорожки пакетного поиска: путь от корня до текущего узла.
+	// upper - ближайший предок, от которого путь ушёл влево (nullptr - без ограничения сверху):
+	// значения поддерева не больше *upper, поэтому для следующего, большего ключа
+	// общий префикс пути сохраняется, пока ключ меньше upper
+	struct BatchLane {
+		struct Step {
+			const Node* node;
+			const T* upper;
+		};
+
+		size_t next = 0;
+		size_t end = 0;
+		std::vector<Step> path;
+	};
+
+	enum class SetOperation { Union, Intersection, Difference };
+
+	// Объединение: все значения a и значения b, ключей которых нет в a.
+	// Пересечение: значения a, ключи которых есть в b.
+	// Разность: значения a, ключей которых нет в b.
+	static Node* combine(Node* a, Node* b, SetOperation operation, int depthBudget) {
+		if (a == nullptr || b == nullptr) {
+			if (operation == SetOperation::Union) {
+				return a ? a : b;
+			}
+			if (operation == SetOperation::Intersection) {
+				clear(a);
+				clear(b);
+				return nullptr;
+			}
+			clear(b);
+			return a;
+		}
+
+		// Разбиение идёт по корню b: так копии ключа из a собираются в equal целиком
+		bool parallel = depthBudget > 0 && static_cast<size_t>(sizeOf(a) + sizeOf(b)) >= parallelThreshold;
+		Node* bl;
+		Node* bm;
+		Node* br;
+		expose(b, bl, bm, br);
+		Node* less;
+		Node* equal;
+		Node* greater;
+		split(a, bm->data, less, equal, greater);
+		if (operation == SetOperation::Union && equal != nullptr) {
+			// Ключ уже есть в a, поэтому остальные его копии из b в объединение не попадают
+			bl = without(bl, bm->data);
+			br = without(br, bm->data);
+		}
+
+		Node* left;
+		Node* right;
+		if (parallel) {
+			auto leftTask = std::async(std::launch::async, [=] {
+				return combine(less, bl, operation, depthBudget - 1);
+				});
+			right = combine(greater, br, operation, depthBudget - 1);
+			left = leftTask.get();
+		}
+		else {
+			left = combine(less, bl, operation, 0);
+			right = combine(greater, br, operation, 0);
+		}
+
+		switch (operation) {
+		case SetOperation::Union:
+			if (equal != nullptr) {
+				clear(bm);
+				return join2(join2(left, equal), right);
+			}
+			return join(left, bm, right);
+		case SetOperation::Intersection:
+			clear(bm);
+			return join2(join2(left, equal), right);
+		default:
+			clear(bm);
+			clear(equal);
+			return join2(left, right);
+		}
+	}
+
+	// Ссылка на узловое представление дерева (массив small переводится в узлы)
+	Node* sharedRoot() const {
+		if (root != nullptr) {
+			return copy(root);
+		}
+		const T* it = small.data();
+		return buildBalanced(it, static_cast<size_t>(smallCount));
+	}
+
+	// Дерево из результата операции; небольшие результаты переводятся обратно в массив
+	static BinaryTree fromRoot(Node* node) {
+		BinaryTree result;
+		result.hashValue = hashOf(node);
+		if (sizeOf(node) <= smallCapacity) {
+			std::vector<T> values;
+			inOrder(node, values);
+			result.assignSorted(values.begin(), values.size());
+			clear(node);
+		}
+		else {
+			result.root = node;
+		}
+		return result;
+	}
+
+	BinaryTree combine(const BinaryTree& another, SetOperation operation) const {
+		int depthBudget = static_cast<size_t>(getSize() + another.getSize()) >= parallelThreshold ? parallelDepthBudget() : 0;
+		return fromRoot(combine(sharedRoot(), another.sharedRoot(), operation, depthBudget));
+	}
+
+public:
+	// Размер пакета, начиная с которого insertSorted строит дерево в несколько потоков
+	static constexpr size_t parallelThreshold = 1 << 16;
+
+	BinaryTree() : root(nullptr) {}
+
+	// Построение сбалансированного дерева из отсортированного диапазона за O(n).
+	// Диапазон проходится дважды, поэтому нужен прямой итератор; для остальных типов
+	// конструктор исключается из перегрузки, а не даёт ошибку внутри тела
+	template <typename It, typename = std::enable_if_t<std::is_base_of<std::forward_iterator_tag,
+		typename std::iterator_traits<It>::iterator_category>::value>>
+	BinaryTree(It first, It last) : root(nullptr) {
+		size_t n = static_cast<size_t>(std::distance(first, last));
+		hashValue = hashRange(first, last);
+		assignSorted(first, n);
+	}
+
+	bool operator<(const BinaryTree& another) const {
+		return getSize() < another.getSize();
+	}
+
+	bool operator>(const BinaryTree& another) const {
+		return getSize() > another.getSize();
+	}
+
+	// Равенство по содержимому: размер и кешированный хеш отсекают почти все
+	// несовпадения за O(1), полное сравнение выполняется только при совпадении хешей
+	bool operator==(const BinaryTree& another) const {
+		if (getSize() != another.getSize() || hashValue != another.hashValue) {
+			return false;
+		}
+		if (root == nullptr && another.root == nullptr) {
+			return std::equal(small.begin(), small.begin() + smallCount, another.small.begin());
+		}
+		if (root == nullptr || another.root == nullptr) {
+			return getValues() == another.getValues();
+		}
+		return root == another.root || equalValues(root, another.root);
+	}
+
+	bool operator!=(const BinaryTree& another) const {
+		return !(*this == another);
+	}
+
+	size_t getHash() const
+	{
+		return hashValue;
+	}
+
+	int getSize() const
+	{
+		return (root ? root->size : smallCount);
+	}
+
+	BinaryTree(const BinaryTree& other) : small(other.small), smallCount(other.smallCount), hashValue(other.hashValue) {
+		Trace::event("Copy Constructor");
+		Trace::copied();
+		root = copy(other.root);
+	}
+
+	BinaryTree(BinaryTree&& other) noexcept
+		: root(other.root), small(other.small), smallCount(other.smallCount), hashValue(other.hashValue) {
+		Trace::event("Move Constructor");
+		Trace::moved();
+		other.root = nullptr;
+		other.smallCount = 0;
+		other.hashValue = 0;
+	}
+
+	BinaryTree& operator=(const BinaryTree& other) {
+		Trace::event("Assignment Operator");
+		Trace::copied();
+		if (this != &other) {
+			clear(root);
+			root = copy(other.root);
+			small = other.small;
+			smallCount = other.smallCount;
+			hashValue = other.hashValue;
+		}
+		return *this;
+	}
+
+	BinaryTree& operator=(BinaryTree&& other) noexcept {
+		Trace::event("Move Assignment Operator");
+		Trace::moved();
+		if (this != &other) {
+			clear(root);
+			root = other.root;
+			small = other.small;
+			smallCount = other.smallCount;
+			hashValue = other.hashValue;
+			other.root = nullptr;
+			other.smallCount = 0;
+			other.hashValue = 0;
+		}
+		return *this;
+	}
+
+	void insert(const T& value) {
+		emplace(value);
+	}
+
+	void insert(T&& value) {
+		emplace(std::move(value));
+	}
+
+	// Создаёт значение из аргументов прямо в новом узле
+	template <typename... Args>
+	void emplace(Args&&... args) {
+		Trace::event("insert");
+		if (root == nullptr && smallCount < smallCapacity) {
+			T value(std::forward<Args>(args)...);
+			hashValue += elementHash(value);
+			// Равные значения встают после существующих, как и при вставке в узлы
+			auto position = std::upper_bound(small.begin(), small.begin() + smallCount, value, Compare());
+			std::move_backward(position, small.begin() + smallCount, small.begin() + smallCount + 1);
+			*position = std::move(value);
+			smallCount++;
+			return;
+		}
+		Node* fresh = allocateNode(std::forward<Args>(args)...);
+		hashValue += fresh->hashSum;
+		if (root == nullptr) {
+			promote();
+		}
+		insertNode(fresh);
+	}
+
+	bool search(const T& value) const {
+		Trace::event("search");
+		return lookup(value) != nullptr;
+	}
+
+	// Значение, эквивалентное key, или nullptr
+	const T* find(const T& key) const {
+		Trace::event("find");
+		return lookup(key);
+	}
+
+	// Гетерогенный поиск при прозрачном Compare: например, std::string_view в дереве std::string
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	const T* find(const K& key) const {
+		Trace::event("find");
+		return lookup(key);
+	}
+
+	// Обходит по возрастанию все значения из [lo, hi], не заходя в поддеревья вне диапазона
+	template <typename Callback>
+	void rangeScan(const T& lo, const T& hi, Callback&& callback) const {
+		Trace::event("rangeScan");
+		if (root == nullptr) {
+			auto first = std::lower_bound(small.begin(), small.begin() + smallCount, lo, Compare());
+			auto last = std::upper_bound(small.begin(), small.begin() + smallCount, hi, Compare());
+			for (; first < last; ++first) {
+				callback(*first);
+			}
+			return;
+		}
+		rangeScan(root, lo, hi, callback);
+	}
+
+	// Поиск пакета ключей, отсортированных по возрастанию; result[i] - найден ли keys[i].
+	// Ключи делятся на batchLanes дорожек, которые спускаются по дереву поочерёдно по одному
+	// узлу, а следующий узел каждой дорожки заранее запрашивается prefetch-ем, так что
+	// промахи кеша разных дорожек перекрываются. Внутри дорожки соседние ключи
+	// продолжают спуск с общего префикса пути, а не от корня.
+	static constexpr size_t batchLanes = 8;
+
+	std::vector<bool> searchBatch(const std::vector<T>& keys) const {
+		Trace::event("searchBatch");
+		std::vector<bool> result(keys.size(), false);
+		if (root == nullptr) {
+			// Слияние двух отсортированных последовательностей
+			int i = 0;
+			for (size_t k = 0; k < keys.size(); ++k) {
+				while (i < smallCount && precedes(small[i], keys[k])) {
+					++i;
+				}
+				result[k] = i < smallCount && !precedes(keys[k], small[i]);
+			}
+			return result;
+		}
+
+		size_t laneCount = std::min(batchLanes, keys.size());
+		std::array<BatchLane, batchLanes> lanes;
+		size_t chunk = laneCount ? (keys.size() + laneCount - 1) / laneCount : 0;
+		size_t active = 0;
+		for (size_t l = 0; l < laneCount; ++l) {
+			BatchLane& lane = lanes[l];
+			lane.next = std::min(keys.size(), l * chunk);
+			lane.end = std::min(keys.size(), lane.next + chunk);
+			lane.path.push_back({ root, nullptr });
+			active += lane.next < lane.end;
+		}
+
+		while (active != 0) {
+			for (size_t l = 0; l < laneCount; ++l) {
+				BatchLane& lane = lanes[l];
+				if (lane.next == lane.end) {
+					continue;
+				}
+				const T& key = keys[lane.next];
+				typename BatchLane::Step step = lane.path.back();
+				bool finished = true;
+				if (step.node != nullptr) {
+					if (equivalent(step.node->data, key)) {
+						result[lane.next] = true;
+					}
+					else {
+						bool goLeft = precedes(key, step.node->data);
+						const Node* child = goLeft ? step.node->left : step.node->right;
+						BINARYTREE_PREFETCH(child);
+						lane.path.push_back({ child, goLeft ? &step.node->data : step.upper });
+						finished = false;
+					}
+				}
+				if (!finished) {
+					continue;
+				}
+
+				// Переход к следующему ключу: подъём до предка, поддерево которого может его содержать
+				if (++lane.next == lane.end) {
+					--active;
+					continue;
+				}
+				const T& nextKey = keys[lane.next];
+				while (lane.path.size() > 1 && (lane.path.back().node == nullptr
+					|| (lane.path.back().upper != nullptr && !precedes(nextKey, *lane.path.back().upper)))) {
+					lane.path.pop_back();
+				}
+			}
+		}
+		return result;
+	}
+
+	// Слияние отсортированного пакета с деревом: значения сливаются за O(n + m),
+	// после чего дерево перестраивается сбалансированным (для больших пакетов - параллельно)
+	template <typename It>
+	void insertSorted(It first, It last) {
+		std::vector<T> current = getValues();
+		std::vector<T> merged;
+		merged.reserve(current.size() + static_cast<size_t>(std::distance(first, last)));
+		std::merge(current.begin(), current.end(), first, last, std::back_inserter(merged), Compare());
+		hashValue += hashRange(first, last);
+
+		clear(root);
+		root = nullptr;
+		smallCount = 0;
+		if (merged.size() >= parallelThreshold) {
+			root = buildBalancedParallel(merged.data(), merged.size(), parallelDepthBudget());
+			traceBuilt(root);
+		}
+		else {
+			assignSorted(merged.data(), merged.size());
+		}
+	}
+
+	// Делит дерево на значения меньше key и значения не меньше key
+	std::pair<BinaryTree, BinaryTree> split(const T& key) const {
+		Node* less;
+		Node* equal;
+		Node* greater;
+		split(sharedRoot(), key, less, equal, greater);
+		return { fromRoot(less), fromRoot(join2(equal, greater)) };
+	}
+
+	// Соединяет два дерева, если все значения left не больше значений right
+	static BinaryTree join(const BinaryTree& left, const BinaryTree& right) {
+		if (left.getSize() != 0 && right.getSize() != 0 && precedes(right.minValue(), left.maxValue())) {
+			throw std::invalid_argument("All values of the left tree must not exceed the values of the right tree.");
+		}
+		return fromRoot(join2(left.sharedRoot(), right.sharedRoot()));
+	}
+
+	// Операции над множествами ключей. Если ключ встречается в дереве несколько раз,
+	// копии берутся из левого операнда: объединение сохраняет все значения *this
+	// и добавляет значения another с новыми ключами. На больших деревьях ветви
+	// рекурсии выполняются параллельно.
+	BinaryTree setUnion(const BinaryTree& another) const {
+		return combine(another, SetOperation::Union);
+	}
+
+	BinaryTree setIntersection(const BinaryTree& another) const {
+		return combine(another, SetOperation::Intersection);
+	}
+
+	BinaryTree setDifference(const BinaryTree& another) const {
+		return combine(another, SetOperation::Difference);
+	}
+
+	// Наименьшее и наибольшее значения непустого дерева
+	const T& minValue() const {
+		if (root == nullptr) {
+			return small[0];
+		}
+		const Node* node = root;
+		while (node->left != nullptr) {
+			node = node->left;
+		}
+		return node->data;
+	}
+
+	const T& maxValue() const {
+		if (root == nullptr) {
+			return small[smallCount - 1];
+		}
+		const Node* node = root;
+		while (node->right != nullptr) {
+			node = node->right;
+		}
+		return node->data;
+	}
+
+	void inOrder() {
+		Trace::event("inOrder");
+		std::cout << *this << std::endl;
+	}
+
+	static void inOrder(const Node* node, std::vector<T>& values) {
+		forEachInOrder(node, [&values](const T& value) { values.push_back(value); });
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const BinaryTree& tree) {
+		for (int i = 0; i < tree.smallCount; ++i) {
+			os << tree.small[i] << " ";
+		}
+		tree.print(os, tree.root);
+		return os;
+	}
+
+	void print(std::ostream& os, const Node* node) const {
+		forEachInOrder(node, [&os](const T& value) { os << value << " "; });
+	}
+
+	std::vector<T> getValues() const {
+		std::vector<T> values;
+		appendValues(values);
+		return values;
+	}
+
+	// Дописывает значения дерева в порядке возрастания в конец values
+	void appendValues(std::vector<T>& values) const {
+		values.insert(values.end(), small.begin(), small.begin() + smallCount);
+		inOrder(root, values);
+	}
+
+	~BinaryTree() {
+		Trace::event("Destructor");
+
+		clear(root);
+	}
+};
+
+// Хеш дерева - хеш содержимого, который дерево поддерживает при каждой вставке.
+// Для значений без std::hash он отключён так же, как std::hash неподдерживаемых типов
+template <typename Tree, bool Enabled>
+struct BinaryTreeHash {
+	size_t operator()(const Tree& tree) const {
+		return tree.getHash();
+	}
+};
+
+template <typename Tree>
+struct BinaryTreeHash<Tree, false> {
+	BinaryTreeHash() = delete;
+	BinaryTreeHash(const BinaryTreeHash&) = delete;
+	BinaryTreeHash& operator=(const BinaryTreeHash&) = delete;
+};
+
+// Специализация std::hash для BinaryTree
+namespace std {
+	template <typename T, typename Compare, typename Trace>
+	struct hash<BinaryTree<T, Compare, Trace>> : BinaryTreeHash<BinaryTree<T, Compare, Trace>, isHashable<T>::value> {};
+}
+
+// Элемент BinaryMap. std::hash для него не определён, поэтому value можно менять на месте:
+// хеши узлов дерева от него не зависят
+template <typename K, typename V>
+struct MapEntry {
+	K key;
+	V value;
+};
+
+// Порядок элементов BinaryMap по ключу; прозрачен, чтобы дерево искало по самому ключу
+template <typename K, typename V, typename Compare>
+struct MapEntryCompare {
+	using is_transparent = void;
+
+	bool operator()(const MapEntry<K, V>& a, const MapEntry<K, V>& b) const {
+		return Compare()(a.key, b.key);
+	}
+
+	template <typename Q>
+	bool operator()(const MapEntry<K, V>& entry, const Q& key) const {
+		return Compare()(entry.key, key);
+	}
+
+	template <typename Q>
+	bool operator()(const Q& key, const MapEntry<K, V>& entry) const {
+		return Compare()(key, entry.key);
+	}
+};
+
+// Ассоциативный массив с уникальными ключами поверх BinaryTree: копирование за O(1)
+// с разделением узлов, поиск по ключу (или по типу, сравнимому с ним, если Compare
+// прозрачен) без создания временного элемента
+template <typename K, typename V, typename Compare = std::less<K>, typename Trace = NoTrace>
+class BinaryMap {
+public:
+	using Entry = MapEntry<K, V>;
+
+	// Добавляет пару, если такого ключа ещё нет; возвращает, добавлена ли она
+	template <typename Key, typename... Args>
+	bool emplace(Key&& key, Args&&... args) {
+		if (tree.find(key) != nullptr) {
+			return false;
+		}
+		tree.emplace(Entry{ K(std::forward<Key>(key)), V(std::forward<Args>(args)...) });
+		return true;
+	}
+
+	bool insert(const K& key, const V& value) {
+		return emplace(key, value);
+	}
+
+	template <typename Q>
+	const V* find(const Q& key) const {
+		const Entry* entry = tree.find(key);
+		return entry ? &entry->value : nullptr;
+	}
+
+	template <typename Q>
+	V* find(const Q& key) {
+		Entry* entry = tree.findForUpdate(key);
+		return entry ? &entry->value : nullptr;
+	}
+
+	template <typename Q>
+	bool contains(const Q& key) const {
+		return tree.find(key) != nullptr;
+	}
+
+	V& operator[](const K& key) {
+		if (V* value = find(key)) {
+			return *value;
+		}
+		tree.emplace(Entry{ key, V() });
+		return *find(key);
+	}
+
+	int getSize() const {
+		return tree.getSize();
+	}
+
+	// Элементы по возрастанию ключей
+	std::vector<Entry> getEntries() const {
+		return tree.getValues();
+	}
+
+private:
+	BinaryTree<Entry, MapEntryCompare<K, V, Compare>, Trace> tree;
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("Cannot open file " + path);
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		length = static_cast<size_t>(fileSize.QuadPart);
+		if (length != 0) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			bytes = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+		}
+#else
+		descriptor = open(path.c_str(), O_RDONLY);
+		if (descriptor < 0) {
+			throw std::runtime_error("Cannot open file " + path);
+		}
+		struct stat info;
+		fstat(descriptor, &info);
+		length = static_cast<size_t>(info.st_size);
+		if (length != 0) {
+			void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			bytes = address == MAP_FAILED ? nullptr : static_cast<const char*>(address);
+		}
+#endif
+		if (length != 0 && bytes == nullptr) {
+			close();
+			throw std::runtime_error("Cannot map file " + path);
+		}
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const {
+		return bytes;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int descriptor = -1;
+#endif
+
+	void close() {
+#ifdef _WIN32
+		if (bytes != nullptr) {
+			UnmapViewOfFile(bytes);
+		}
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+#else
+		if (bytes != nullptr) {
+			munmap(const_cast<char*>(bytes), length);
+		}
+		if (descriptor >= 0) {
+			::close(descriptor);
+		}
+#endif
+		bytes = nullptr;
+	}
+};
+
+// Двоичный формат коллекции деревьев ("замороженный" массив, порядок байт платформы):
+//   заголовок TreeFileHeader;
+//   uint64_t offsets[treeCount + 1] - начало значений каждого дерева, в элементах;
+//   T values[offsets[treeCount]] - значения всех деревьев подряд, каждое дерево по возрастанию.
+// Отсортированный массив - это дерево поиска в неявном виде, поэтому загруженный
+// файл пригоден для поиска прямо из отображённой памяти, без создания узлов.
+struct TreeFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t valueSize;
+	uint64_t treeCount;
+};
+
+constexpr char treeFileMagic[8] = { 'B', 'T', 'R', 'E', 'E', 'S', '\0', '\0' };
+constexpr uint32_t treeFileVersion = 1;
+
+// Сохраняет коллекцию деревьев в файл одной операцией записи
+template <typename T, typename Compare, typename Trace>
+void saveTrees(const std::string& path, const std::vector<BinaryTree<T, Compare, Trace>>& trees) {
+	static_assert(std::is_trivially_copyable<T>::value, "Binary tree files support only trivially copyable values");
+
+	uint64_t totalValues = 0;
+	for (const auto& tree : trees) {
+		totalValues += static_cast<uint64_t>(tree.getSize());
+	}
+
+	TreeFileHeader header{};
+	std::memcpy(header.magic, treeFileMagic, sizeof(header.magic));
+	header.version = treeFileVersion;
+	header.valueSize = sizeof(T);
+	header.treeCount = trees.size();
+
+	std::vector<uint64_t> offsets;
+	offsets.reserve(trees.size() + 1);
+	std::vector<T> values;
+	values.reserve(static_cast<size_t>(totalValues));
+	for (const auto& tree : trees) {
+		offsets.push_back(values.size());
+		tree.appendValues(values);
+	}
+	offsets.push_back(values.size());
+
+	size_t offsetsBytes = offsets.size() * sizeof(uint64_t);
+	std::vector<char> buffer(sizeof(header) + offsetsBytes + values.size() * sizeof(T));
+	std::memcpy(buffer.data(), &header, sizeof(header));
+	std::memcpy(buffer.data() + sizeof(header), offsets.data(), offsetsBytes);
+	if (!values.empty()) {
+		std::memcpy(buffer.data() + sizeof(header) + offsetsBytes, values.data(), values.size() * sizeof(T));
+	}
+
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	if (!output) {
+		throw std::runtime_error("Cannot write file " + path);
+	}
+}
+
+template <typename T, typename Compare, typename Trace>
+void saveTree(const std::string& path, const BinaryTree<T, Compare, Trace>& tree) {
+	saveTrees(path, std::vector<BinaryTree<T, Compare, Trace>>{ tree });
+}
+
+// Неизменяемое дерево поверх массива в отображённой памяти, отсортированного по Compare
+template <typename T, typename Compare = std::less<T>>
+class FrozenTreeView {
+public:
+	FrozenTreeView(const T* values, size_t count) : values(values), count(count) {}
+
+	bool search(const T& value) const {
+		return std::binary_search(values, values + count, value, Compare());
+	}
+
+	int getSize() const {
+		return static_cast<int>(count);
+	}
+
+	const T* begin() const {
+		return values;
+	}
+
+	const T* end() const {
+		return values + count;
+	}
+
+	// Полноценное изменяемое дерево с теми же значениями, строится за O(n)
+	BinaryTree<T, Compare> toTree() const {
+		return BinaryTree<T, Compare>(begin(), end());
+	}
+
+private:
+	const T* values;
+	size_t count;
+};
+
+// Коллекция деревьев, сохранённая saveTrees и отображённая в память.
+// Файл хранит значения в порядке Compare сохранённых деревьев, но не сам Compare,
+// поэтому читать его нужно с тем же Compare, с которым он был записан
+template <typename T, typename Compare = std::less<T>>
+class FrozenTreeCollection {
+public:
+	explicit FrozenTreeCollection(const std::string& path) : file(path) {
+		static_assert(std::is_trivially_copyable<T>::value, "Binary tree files support only trivially copyable values");
+
+		if (file.size() < sizeof(TreeFileHeader)) {
+			throw std::runtime_error("Tree file is truncated: " + path);
+		}
+		TreeFileHeader header;
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, treeFileMagic, sizeof(header.magic)) != 0 || header.version != treeFileVersion) {
+			throw std::runtime_error("Not a binary tree file: " + path);
+		}
+		if (header.valueSize != sizeof(T)) {
+			throw std::runtime_error("Tree file value size does not match: " + path);
+		}
+		// Размеры сравниваются делением, чтобы повреждённые счётчики не переполнили умножение
+		if (header.treeCount >= (file.size() - sizeof(header)) / sizeof(uint64_t)) {
+			throw std::runtime_error("Tree file is truncated: " + path);
+		}
+		treeCount = static_cast<size_t>(header.treeCount);
+		size_t offsetsBytes = (treeCount + 1) * sizeof(uint64_t);
+		offsets = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+		values = reinterpret_cast<const T*>(file.data() + sizeof(header) + offsetsBytes);
+		if (offsets[treeCount] > (file.size() - sizeof(header) - offsetsBytes) / sizeof(T)) {
+			throw std::runtime_error("Tree file is truncated: " + path);
+		}
+		// operator[] не проверяет границы, поэтому таблица смещений проверяется здесь целиком
+		for (size_t i = 0; i < treeCount; ++i) {
+			if (offsets[i] > offsets[i + 1]) {
+				throw std::runtime_error("Tree file has a corrupted offsets table: " + path);
+			}
+		}
+	}
+
+	size_t size() const {
+		return treeCount;
+	}
+
+	FrozenTreeView<T, Compare> operator[](size_t index) const {
+		return FrozenTreeView<T, Compare>(values + offsets[index], static_cast<size_t>(offsets[index + 1] - offsets[index]));
+	}
+
+	std::vector<BinaryTree<T, Compare>> load() const {
+		std::vector<BinaryTree<T, Compare>> trees;
+		trees.reserve(treeCount);
+		for (size_t i = 0; i < treeCount; ++i) {
+			trees.push_back((*this)[i].toTree());
+		}
+		return trees;
+	}
+
+private:
+	MappedFile file;
+	size_t treeCount = 0;
+	const uint64_t* offsets = nullptr;
+	const T* values = nullptr;
+};
+
+// Шаг splitmix64: биективно перемешивает 64-битное значение
+inline uint64_t splitmix64(uint64_t x) {
+	uint64_t z = x + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Генератор xoshiro256** (Blackman, Vigna): быстрый, с состоянием 256 бит,
+// инициализируется через splitmix64 из одного 64-битного ключа
+class Xoshiro256 {
+public:
+	explicit Xoshiro256(uint64_t seed) {
+		for (auto& word : state) {
+			word = splitmix64(seed);
+			seed += 0x9e3779b97f4a7c15ULL;
+		}
+	}
+
+	uint64_t next() {
+		uint64_t result = rotl(state[1] * 5, 7) * 9;
+		uint64_t t = state[1] << 17;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotl(state[3], 45);
+		return result;
+	}
+
+	// Равномерное целое в [lo, hi] без смещения остатка от деления
+	int uniform(int lo, int hi) {
+		uint64_t bound = static_cast<uint64_t>(static_cast<int64_t>(hi) - lo) + 1;
+		uint64_t threshold = (0 - bound) % bound;
+		uint64_t x = next();
+		while (x < threshold) {
+			x = next();
+		}
+		return static_cast<int>(lo + static_cast<int64_t>(x % bound));
+	}
+
+private:
+	uint64_t state[4];
+
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+};
+
+// Воспроизводимый генератор случайных деревьев для нагрузки и бенчмарков.
+// Дерево с номером i строится из собственного потока xoshiro256**, ключ которого
+// выводится из (seed, i), поэтому результат зависит только от seed, а не от числа потоков
+// и порядка генерации. Дерево строится из отсортированных значений за O(n).
+class RandomTreeGenerator {
+public:
+	using Distribution = std::function<int(Xoshiro256&)>;
+
+	static Distribution uniform(int lo, int hi) {
+		return [lo, hi](Xoshiro256& rng) { return rng.uniform(lo, hi); };
+	}
+
+	struct Options {
+		Distribution treeSize = uniform(2, 12);
+		Distribution value = uniform(0, 99);
+	};
+
+	explicit RandomTreeGenerator(uint64_t seed) : seed(seed) {}
+
+	RandomTreeGenerator(uint64_t seed, Options options) : seed(seed), options(std::move(options)) {}
+
+	BinaryTree<int> tree(uint64_t index) const {
+		// seed перемешивается до сложения с index: при линейной комбинации разные пары
+		// (seed, index) давали бы один ключ, и потоки разных seed совпадали бы со сдвигом
+		Xoshiro256 rng(splitmix64(splitmix64(seed) + index));
+		int count = std::max(0, options.treeSize(rng));
+		std::vector<int> values(count);
+		for (int& value : values) {
+			value = options.value(rng);
+		}
+		std::sort(values.begin(), values.end());
+		return BinaryTree<int>(values.begin(), values.end());
+	}
+
+	// Деревья с номерами [first, first + count), в threads потоках (0 - по числу ядер)
+	std::vector<BinaryTree<int>> generate(size_t count, uint64_t first = 0, unsigned threads = 0) const {
+		std::vector<BinaryTree<int>> trees(count);
+		if (threads == 0) {
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, count / 1024)));
+
+		auto fill = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				trees[i] = tree(first + i);
+			}
+			};
+		if (threads == 1) {
+			fill(0, count);
+			return trees;
+		}
+		std::vector<std::thread> workers;
+		size_t chunk = (count + threads - 1) / threads;
+		for (unsigned t = 0; t < threads; ++t) {
+			size_t begin = std::min(count, t * chunk);
+			workers.emplace_back(fill, begin, std::min(count, begin + chunk));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		return trees;
+	}
+
+private:
+	uint64_t seed;
+	Options options;
+};
+
+// Потокобезопасный вариант дерева для сценария "много читателей, несколько писателей".
+// Узлы никогда не удаляются до разрушения дерева, поэтому поиск обходится без блокировок
+// и без схемы отложенного освобождения памяти (RCU/epoch): прочитанный указатель всегда валиден.
+// Вставка оптимистична: спуск идёт без блокировок, а новый узел подвешивается CAS-ом
+// на пустую ссылку; если другой поток успел занять её первым, спуск продолжается с его узла.
+template <typename T>
+class ConcurrentBinaryTree {
+private:
+	struct Node {
+		const T data;
+		std::atomic<Node*> left{ nullptr };
+		std::atomic<Node*> right{ nullptr };
+
+		Node(const T& value) : data(value) {}
+	};
+
+	std::atomic<Node*> root{ nullptr };
+	std::atomic<size_t> count{ 0 };
+	std::atomic<size_t> conflictCount{ 0 }; // CAS, проигранные другому писателю
+
+	static void clear(Node* node) {
+		if (node != nullptr) {
+			clear(node->left.load(std::memory_order_relaxed));
+			clear(node->right.load(std::memory_order_relaxed));
+			delete node;
+		}
+	}
+
+	static void inOrder(const Node* node, std::vector<T>& values) {
+		if (node != nullptr) {
+			inOrder(node->left.load(std::memory_order_acquire), values);
+			values.push_back(node->data);
+			inOrder(node->right.load(std::memory_order_acquire), values);
+		}
+	}
+
+public:
+	ConcurrentBinaryTree() = default;
+	ConcurrentBinaryTree(const ConcurrentBinaryTree&) = delete;
+	ConcurrentBinaryTree& operator=(const ConcurrentBinaryTree&) = delete;
+
+	void insert(const T& value) {
+		Node* newNode = new Node(value);
+		std::atomic<Node*>* link = &root;
+		while (true) {
+			Node* current = link->load(std::memory_order_acquire);
+			if (current == nullptr) {
+				// release публикует data нового узла для читателей, загружающих ссылку с acquire
+				if (link->compare_exchange_weak(current, newNode, std::memory_order_release, std::memory_order_acquire)) {
+					count.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				if (current == nullptr) {
+					continue; // ложный отказ compare_exchange_weak
+				}
+				conflictCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			link = (value < current->data) ? &current->left : &current->right;
+		}
+	}
+
+	bool search(const T& value) const {
+		const Node* node = root.load(std::memory_order_acquire);
+		while (node != nullptr) {
+			if (node->data == value) {
+				return true;
+			}
+			node = (value < node->data) ? node->left.load(std::memory_order_acquire)
+				: node->right.load(std::memory_order_acquire);
+		}
+		return false;
+	}
+
+	size_t getSize() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	// Сколько раз вставка теряла пустую ссылку из-за другого писателя и продолжала спуск
+	size_t getConflicts() const {
+		return conflictCount.load(std::memory_order_relaxed);
+	}
+
+	// Снимок значений; при параллельных вставках содержит часть из них
+	std::vector<T> getValues() const {
+		std::vector<T> values;
+		inOrder(root.load(std::memory_order_acquire), values);
+		return values;
+	}
+
+	~ConcurrentBinaryTree() {
+		clear(root.load(std::memory_order_relaxed));
+	}
+};
+
+// Стресс-тест и замер пропускной способности ConcurrentBinaryTree:
+// писатели (1, 2, 4) поочерёдно делят ключи между собой, так что их вставки спорят
+// за одни и те же ветви, остальные потоки параллельно ищут ключи.
+// После каждого прогона проверяется, что дерево содержит ровно вставленные ключи:
+// ни одна вставка не потеряна при проигранном CAS и ни одна не выполнена дважды.
+int benchmarkConcurrentTree()
+{
+	const int keysCount = 200000;
+	const int searchesPerReader = 400000;
+
+	// Перемешанные различные ключи, чтобы несбалансированное дерево не выродилось в список:
+	// умножение на нечётное число по модулю 2^31 - биекция
+	std::vector<int> keys(keysCount);
+	for (int i = 0; i < keysCount; ++i) {
+		keys[i] = static_cast<int>((static_cast<uint32_t>(i) * 0x9e3779b1u) & 0x7fffffff);
+	}
+	std::vector<int> expected = keys;
+	std::sort(expected.begin(), expected.end());
+
+	unsigned maxReaders = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned writers = 1; writers <= 4; writers *= 2)
+	for (unsigned readers = 1; readers <= maxReaders; readers *= 2) {
+		ConcurrentBinaryTree<int> tree;
+		std::atomic<long long> hits{ 0 };
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> writerThreads;
+		for (unsigned w = 0; w < writers; ++w) {
+			writerThreads.emplace_back([&, w] {
+				for (size_t i = w; i < keys.size(); i += writers) {
+					tree.insert(keys[i]);
+				}
+				});
+		}
+		std::vector<std::thread> readerThreads;
+		for (unsigned r = 0; r < readers; ++r) {
+			readerThreads.emplace_back([&, r] {
+				long long localHits = 0;
+				uint32_t state = 2463534242u + r;
+				for (int i = 0; i < searchesPerReader; ++i) {
+					state ^= state << 13;
+					state ^= state >> 17;
+					state ^= state << 5;
+					localHits += tree.search(keys[state % keysCount]);
+				}
+				hits += localHits;
+				});
+		}
+		for (auto& thread : writerThreads) {
+			thread.join();
+		}
+		for (auto& thread : readerThreads) {
+			thread.join();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool ok = tree.getSize() == expected.size();
+		for (int key : keys) {
+			ok = ok && tree.search(key);
+		}
+		ok = ok && tree.getValues() == expected;
+		if (!ok) {
+			std::cout << "ConcurrentBinaryTree: stress test failed with " << writers << " writers and "
+				<< readers << " readers" << std::endl;
+			return 1;
+		}
+
+		double operations = keysCount + static_cast<double>(readers) * searchesPerReader;
+		std::cout << "writers: " << writers << ", readers: " << readers
+			<< ", ops/s: " << static_cast<long long>(operations / seconds)
+			<< ", hits: " << hits.load()
+			<< ", CAS conflicts: " << tree.getConflicts() << std::endl;
+	}
+	return 0;
+}
+
+// Этап ранжирования конвейера: выбор k наибольших или наименьших деревьев по размеру.
+// Сравнения идут по компактному массиву ключей (размер, индекс), а не через root->size
+// разбросанных по куче узлов, и вместо полной сортировки используется nth_element.
+// Буферы переиспользуются между вызовами, поэтому повторный выбор не выделяет память.
+class TreeRanking {
+public:
+	enum class Order { Largest, Smallest };
+
+	// Размер коллекции, начиная с которого ключи собираются и отбираются в нескольких потоках
+	static constexpr size_t parallelThreshold = 1 << 20;
+
+	// Возвращает индексы k выбранных деревьев, упорядоченные по размеру
+	// (при равных размерах - по индексу, чтобы результат не зависел от числа потоков)
+	template <typename Tree>
+	const std::vector<uint32_t>& select(const std::vector<Tree>& trees, size_t k, Order order) {
+		k = std::min(k, trees.size());
+		keys.resize(trees.size());
+		selected.clear();
+
+		unsigned threads = trees.size() >= parallelThreshold ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+		if (threads == 1) {
+			fillKeys(trees, 0, trees.size());
+			selectInPlace(keys.begin(), keys.end(), k, order);
+		}
+		else {
+			// Каждый поток отбирает k лучших в своей части, затем отбор повторяется среди победителей
+			size_t chunk = (trees.size() + threads - 1) / threads;
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t) {
+				size_t first = std::min(trees.size(), t * chunk);
+				size_t last = std::min(trees.size(), first + chunk);
+				workers.emplace_back([this, &trees, first, last, k, order] {
+					fillKeys(trees, first, last);
+					selectInPlace(keys.begin() + first, keys.begin() + last, k, order);
+					});
+			}
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			size_t candidates = 0;
+			for (unsigned t = 0; t < threads; ++t) {
+				size_t first = std::min(trees.size(), t * chunk);
+				size_t count = std::min(k, std::min(trees.size(), first + chunk) - first);
+				// Победители сдвигаются к началу; candidates <= first, но диапазоны могут перекрываться
+				if (candidates + count <= first) {
+					std::move(keys.begin() + first, keys.begin() + first + count, keys.begin() + candidates);
+				}
+				else if (candidates != first) {
+					for (size_t i = 0; i < count; ++i) {
+						keys[candidates + i] = std::move(keys[first + i]);
+					}
+				}
+				candidates += count;
+			}
+			selectInPlace(keys.begin(), keys.begin() + candidates, k, order);
+		}
+
+		for (size_t i = 0; i < k; ++i) {
+			selected.push_back(keys[i].second);
+		}
+		return selected;
+	}
+
+private:
+	using Key = std::pair<int, uint32_t>;
+
+	std::vector<Key> keys;
+	std::vector<uint32_t> selected;
 
-	void insert(Node*& node, T value) {
-		if (node == nullptr) {
-			node = new Node(value);
-		}
-		else if (value < node->data) {
-			insert(node->left, value);
-			node->size++;
+	template <typename Tree>
+	void fillKeys(const std::vector<Tree>& trees, size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			keys[i] = Key(trees[i].getSize(), static_cast<uint32_t>(i));
 		}
-		else {
-			insert(node->right, value);
-			node->size++;
+	}
+
+	// Переносит k лучших ключей диапазона в его начало и сортирует только их
+	static void selectInPlace(std::vector<Key>::iterator first, std::vector<Key>::iterator last, size_t k, Order order) {
+		auto comparator = [order](const Key& a, const Key& b) {
+			if (a.first != b.first) {
+				return order == Order::Largest ? a.first > b.first : a.first < b.first;
+			}
+			return a.second < b.second;
+			};
+		k = std::min(k, static_cast<size_t>(last - first));
+		if (k < static_cast<size_t>(last - first)) {
+			std::nth_element(first, first + k, last, comparator);
 		}
+		std::sort(first, first + k, comparator);
 	}
+};
 
-	bool search(Node* node, T value) {
-		if (node == nullptr) {
-			return false;
+// Удаляет из вектора элементы с указанными индексами, сохраняя порядок остальных
+template <typename Tree>
+void eraseIndices(std::vector<Tree>& trees, std::vector<uint32_t> indices) {
+	std::sort(indices.begin(), indices.end());
+	size_t write = 0;
+	size_t next = 0;
+	for (size_t read = 0; read < trees.size(); ++read) {
+		if (next < indices.size() && indices[next] == read) {
+			++next;
+			continue;
 		}
-		if (node->data == value) {
-			return true;
+		if (write != read) {
+			trees[write] = std::move(trees[read]);
 		}
-		else if (value < node->data) {
-			return search(node->left, value);
+		++write;
+	}
+	trees.resize(write);
+}
+
+// Устойчивое разбиение: элементы, удовлетворяющие pred, переносятся в начало с сохранением
+// порядка. В отличие от std::stable_partition временный буфер передаёт вызывающий,
+// поэтому при заранее зарезервированном scratch разбиение не выделяет память.
+template <typename Tree, typename Pred>
+size_t stablePartition(std::vector<Tree>& trees, Pred pred, std::vector<Tree>& scratch) {
+	scratch.clear();
+	size_t write = 0;
+	for (size_t read = 0; read < trees.size(); ++read) {
+		if (pred(trees[read])) {
+			if (write != read) {
+				trees[write] = std::move(trees[read]);
+			}
+			++write;
 		}
 		else {
-			return search(node->right, value);
+			scratch.push_back(std::move(trees[read]));
 		}
 	}
+	std::move(scratch.begin(), scratch.end(), trees.begin() + write);
+	scratch.clear();
+	return write;
+}
 
-	void inOrder(Node* node) {
-		if (node != nullptr) {
-			inOrder(node->left);
-			std::cout << node->data << " ";
-			inOrder(node->right);
+// Дедупликация по кешированному хешу деревьев с открытой адресацией: вместо узла
+// unordered_set на каждый элемент используется одна таблица индексов в unique.
+// Таблица должна иметь размер степени двойки, превышающий итоговое число уникальных деревьев.
+template <typename Tree>
+void appendUnique(const std::vector<Tree>& trees, std::vector<Tree>& unique, std::vector<uint32_t>& table) {
+	const size_t mask = table.size() - 1;
+	for (const auto& tree : trees) {
+		size_t slot = tree.getHash() & mask;
+		while (true) {
+			uint32_t entry = table[slot];
+			if (entry == 0) {
+				unique.push_back(tree);
+				table[slot] = static_cast<uint32_t>(unique.size()); // индекс + 1, 0 - пустая ячейка
+				break;
+			}
+			if (unique[entry - 1] == tree) {
+				break;
+			}
+			slot = (slot + 1) & mask;
 		}
 	}
+}
 
-	void clear(Node* node) {
-		if (node != nullptr) {
-			clear(node->left);
-			clear(node->right);
-			delete node;
+// Очередь без блокировок для одного производителя и одного потребителя.
+// Ёмкость ограничена: push ждёт, пока потребитель освободит место, что даёт
+// обратное давление между этапами конвейера.
+template <typename T>
+class SpscQueue {
+public:
+	explicit SpscQueue(size_t capacity) {
+		size_t rounded = 1;
+		while (rounded < capacity) {
+			rounded *= 2;
 		}
+		slots.resize(rounded);
+		mask = rounded - 1;
 	}
 
-	Node* copy(Node* node) {
-		if (node == nullptr) {
-			return nullptr;
+	void push(T value) {
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+		while (tail - headIndex.load(std::memory_order_acquire) == slots.size()) {
+			std::this_thread::yield();
 		}
-		Node* newNode = new Node(node->data);
-		newNode->left = copy(node->left);
-		newNode->right = copy(node->right);
-		return newNode;
+		slots[tail & mask] = std::move(value);
+		tailIndex.store(tail + 1, std::memory_order_release);
 	}
 
-public:
-	BinaryTree() : root(nullptr) {}
-
-	bool operator<(const BinaryTree<T>& another) const {
-		return (this->root ? this->root->size : 0) < (another.root ? another.root->size : 0);
+	// Возвращает false, когда очередь закрыта и все элементы уже извлечены
+	bool pop(T& value) {
+		size_t head = headIndex.load(std::memory_order_relaxed);
+		while (head == tailIndex.load(std::memory_order_acquire)) {
+			if (closed.load(std::memory_order_acquire) && head == tailIndex.load(std::memory_order_acquire)) {
+				return false;
+			}
+			std::this_thread::yield();
+		}
+		value = std::move(slots[head & mask]);
+		headIndex.store(head + 1, std::memory_order_release);
+		return true;
 	}
 
-	bool operator>(const BinaryTree<T>& another) const {
-		return (this->root ? this->root->size : 0) > (another.root ? another.root->size : 0);
+	// Вызывается производителем после последнего push
+	void close() {
+		closed.store(true, std::memory_order_release);
 	}
 
-	bool operator==(const BinaryTree<T>& another) const {
-		return (this->root ? this->root->size : 0) == (another.root ? another.root->size : 0);
-	}
+private:
+	std::vector<T> slots;
+	size_t mask = 0;
+	alignas(64) std::atomic<size_t> headIndex{ 0 };
+	alignas(64) std::atomic<size_t> tailIndex{ 0 };
+	std::atomic<bool> closed{ false };
+};
 
-	int getSize() const
-	{
-		return (root ? root->size : 0);
-	}
+// Потоковый режим конвейера lab3 для входов, которые не помещаются в память.
+// Этапы работают в своих потоках и связаны очередями SpscQueue:
+//   источник -> ранжирование (top-n1 и окно последних tailSize деревьев) -> дедупликация.
+// Блокирующие этапы пакетного конвейера заменены ограниченными сводками: куча из n1
+// наибольших деревьев, кольцевой буфер хвоста и сумма размеров для среднего.
+// Память ограничена ёмкостью очередей, n1, n2 и tailSize плюс множеством уникальных деревьев.
+// В отличие от пакетного режима остаток v1 идёт дальше в порядке вытеснения из кучи,
+// поэтому v4 составляется из первых вытесненных деревьев, а не из первых по исходному порядку.
+class StreamingTreePipeline {
+public:
+	using Tree = BinaryTree<int>;
+	using Source = std::function<bool(Tree&)>;
+	using UniqueSink = std::function<void(const Tree&)>;
 
-	BinaryTree(const BinaryTree& other) {
-		if (debug)
-			std::cout << "Copy Constructor" << std::endl;
-		root = copy(other.root);
+	struct Options {
+		size_t tailSize = 200;
+		size_t n1 = 20;
+		size_t n2 = 20;
+		size_t queueCapacity = 1024;
+	};
+
+	struct Result {
+		size_t processed = 0;
+		size_t uniqueCount = 0;
+		double averageSize = 0.0;
+		std::vector<Tree> list1;
+		std::vector<Tree> list2;
+		std::vector<std::pair<Tree, Tree>> list3;
+		std::vector<std::pair<Tree, Tree>> v4;
+	};
+
+	explicit StreamingTreePipeline(Options options) : options(options) {}
+
+	Result run(Source source, UniqueSink onUnique) {
+		Result result;
+		SpscQueue<Tree> generated(options.queueCapacity);
+		SpscQueue<std::pair<bool, Tree>> rest(options.queueCapacity); // (из хвоста v2?, дерево)
+
+		std::thread sourceThread([&] {
+			Tree tree;
+			while (source(tree)) {
+				generated.push(std::move(tree));
+				tree = Tree();
+			}
+			generated.close();
+			});
+		std::thread rankingThread([&] {
+			rank(generated, rest, result);
+			});
+		deduplicate(rest, onUnique, result);
+
+		sourceThread.join();
+		rankingThread.join();
+
+		finish(result);
+		return result;
 	}
 
-	BinaryTree(BinaryTree&& other) noexcept : root(other.root) {
-		if (debug)
-			std::cout << "Move Constructor" << std::endl;
-		other.root = nullptr;
+private:
+	Options options;
+
+	// Этап ранжирования: держит n1 наибольших деревьев в куче с минимумом на вершине,
+	// а остальные сразу отправляет на дедупликацию как остаток v1
+	void rank(SpscQueue<Tree>& input, SpscQueue<std::pair<bool, Tree>>& output, Result& result) {
+		auto smallerOnTop = [](const Tree& a, const Tree& b) { return a > b; };
+		std::vector<Tree> top;
+		top.reserve(options.n1 + 1);
+		std::vector<Tree> tail(options.tailSize);
+		size_t processed = 0;
+
+		Tree tree;
+		while (input.pop(tree)) {
+			if (options.tailSize != 0) {
+				tail[processed % options.tailSize] = tree; // копия за O(1) за счёт разделения узлов
+			}
+			++processed;
+
+			if (top.size() < options.n1) {
+				top.push_back(std::move(tree));
+				std::push_heap(top.begin(), top.end(), smallerOnTop);
+			}
+			else if (!top.empty() && tree > top.front()) {
+				std::pop_heap(top.begin(), top.end(), smallerOnTop);
+				output.push({ false, std::move(top.back()) });
+				top.back() = std::move(tree);
+				std::push_heap(top.begin(), top.end(), smallerOnTop);
+			}
+			else {
+				output.push({ false, std::move(tree) });
+			}
+		}
+
+		// Окно хвоста в исходном порядке: n2 наименьших уходят в list2, остальное - остаток v2
+		size_t tailCount = std::min(processed, options.tailSize);
+		std::rotate(tail.begin(), tail.begin() + (processed > options.tailSize ? processed % options.tailSize : 0), tail.end());
+		tail.resize(tailCount);
+		TreeRanking ranking;
+		const std::vector<uint32_t>& smallest = ranking.select(tail, options.n2, TreeRanking::Order::Smallest);
+		for (uint32_t index : smallest) {
+			result.list2.push_back(std::move(tail[index]));
+		}
+		eraseIndices(tail, smallest);
+		for (auto& tailTree : tail) {
+			output.push({ true, std::move(tailTree) });
+		}
+		output.close();
+
+		std::sort_heap(top.begin(), top.end(), smallerOnTop);
+		result.list1 = std::move(top);
+		result.processed = processed;
 	}
 
-	BinaryTree& operator=(const BinaryTree& other) {
-		if (debug)
-			std::cout << "Assignment Operator" << std::endl;
-		if (this != &other) {
-			clear(root);
-			root = copy(other.root);
+	// Этап дедупликации; заодно запоминает первые tailSize деревьев остатка v1 для v4
+	void deduplicate(SpscQueue<std::pair<bool, Tree>>& input, UniqueSink& onUnique, Result& result) {
+		std::unordered_set<Tree> unique;
+		std::vector<Tree> restV1;
+		restV1.reserve(options.tailSize);
+
+		std::pair<bool, Tree> item;
+		while (input.pop(item)) {
+			Tree& tree = item.second;
+			if (unique.insert(tree).second && onUnique) {
+				onUnique(tree);
+			}
+			if (item.first) {
+				if (result.v4.size() < restV1.size()) {
+					result.v4.emplace_back(std::move(restV1[result.v4.size()]), std::move(tree));
+				}
+			}
+			else if (restV1.size() < options.tailSize) {
+				restV1.push_back(std::move(tree));
+			}
 		}
-		return *this;
+		result.uniqueCount = unique.size();
 	}
 
-	BinaryTree& operator=(BinaryTree&& other) noexcept {
-		if (debug)
-			std::cout << "Move Assignment Operator" << std::endl;
-		if (this != &other) {
-			clear(root);
-			root = other.root;
-			other.root = nullptr;
+	// Завершающие шаги над ограниченными по размеру list1 и list2
+	void finish(Result& result) {
+		int totalSize = 0;
+		for (const auto& tree : result.list1) {
+			totalSize += tree.getSize();
+		}
+		result.averageSize = result.list1.empty() ? 0.0 : static_cast<double>(totalSize) / result.list1.size();
+
+		std::vector<Tree> scratch;
+		scratch.reserve(result.list1.size());
+		double averageSize = result.averageSize;
+		stablePartition(result.list1, [averageSize](const Tree& tree) {
+			return tree.getSize() > averageSize;
+			}, scratch);
+
+		result.list2.erase(std::remove_if(result.list2.begin(), result.list2.end(), [](const Tree& tree) {
+			return tree.getSize() % 2 != 0;
+			}), result.list2.end());
+
+		size_t pairs = std::min(result.list1.size(), result.list2.size());
+		size_t skip1 = result.list1.size() - pairs;
+		size_t skip2 = result.list2.size() - pairs;
+		result.list3.reserve(pairs);
+		for (size_t i = 0; i < pairs; ++i) {
+			result.list3.emplace_back(result.list1[skip1 + i], result.list2[skip2 + i]);
 		}
-		return *this;
 	}
+};
+
+// Потоковый прогон конвейера на count случайных деревьях
+int runStreamingPipeline(long long count, uint64_t seed)
+{
+	Xoshiro256 rng(seed);
+	StreamingTreePipeline::Options options;
+	options.n1 = rng.uniform(20, 50);
+	options.n2 = rng.uniform(20, 50);
+	StreamingTreePipeline pipeline(options);
+	RandomTreeGenerator generator(seed);
 
-	void insert(T value) {
-		if (debug)
-			std::cout << "insert" << std::endl;
-		insert(root, value);
+	long long generated = 0;
+	auto start = std::chrono::steady_clock::now();
+	StreamingTreePipeline::Result result = pipeline.run([&](BinaryTree<int>& tree) {
+		if (generated == count) {
+			return false;
+		}
+		tree = generator.tree(generated++);
+		return true;
+		}, nullptr);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "trees: " << result.processed << ", unique: " << result.uniqueCount
+		<< ", list1: " << result.list1.size() << ", list2: " << result.list2.size()
+		<< ", list3: " << result.list3.size() << ", v4: " << result.v4.size()
+		<< ", average size: " << result.averageSize
+		<< ", trees/s: " << static_cast<long long>(result.processed / seconds) << std::endl;
+	return 0;
+}
+
+// Счётчики выделений памяти для режима bench. Глобальные operator new/delete заменены
+// обёртками над malloc/free. Счётчики меняются, только пока идёт замер (allocationCounting
+// выставляет Probe), поэтому в остальных режимах каждое выделение обходится одним чтением
+// флага, строка кеша которого не меняется, а не двумя атомарными операциями над общими счётчиками.
+// delete не встраивается: иначе GCC видит free() от указателя из operator new и предупреждает
+std::atomic<bool> allocationCounting{ false };
+std::atomic<unsigned long long> allocationCount{ 0 };
+std::atomic<unsigned long long> allocationBytes{ 0 };
+
+void* operator new(std::size_t size) {
+	if (allocationCounting.load(std::memory_order_relaxed)) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocationBytes.fetch_add(size, std::memory_order_relaxed);
 	}
+	if (void* pointer = std::malloc(size != 0 ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
 
-	bool search(T value) {
-		if (debug)
-			std::cout << "search" << std::endl;
-		return search(root, value);
+BINARYTREE_NOINLINE void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+BINARYTREE_NOINLINE void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+// Аппаратные счётчики через perf_event (только Linux). Считают поток, создавший счётчики,
+// и все потоки, запущенные им позже (inherit): счёт завершившегося потока прибавляется
+// к родителю, поэтому рабочие потоки замера должны быть присоединены до stop().
+// Каждое событие открывается отдельно: в виртуальных машинах часть из них бывает
+// недоступна, и такие значения выводятся как null
+class HardwareCounters {
+public:
+	static constexpr int eventCount = 4;
+	static constexpr const char* names[eventCount] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+	using Values = std::array<long long, eventCount>; // -1 - событие недоступно
+
+	HardwareCounters() {
+		descriptors.fill(-1);
+#ifdef __linux__
+		const uint64_t configs[eventCount] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+		for (int i = 0; i < eventCount; ++i) {
+			perf_event_attr attributes{};
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = configs[i];
+			attributes.disabled = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.inherit = 1; // конвейер и параллельное построение работают в других потоках
+			descriptors[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+		}
+#endif
 	}
 
-	void inOrder() {
-		if (debug)
-			std::cout << "inOrder" << std::endl;
-		inOrder(root);
-		std::cout << std::endl;
+	HardwareCounters(const HardwareCounters&) = delete;
+	HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+	bool available() const {
+		return std::any_of(descriptors.begin(), descriptors.end(), [](int descriptor) { return descriptor >= 0; });
 	}
 
-	void inOrder(Node* node, std::vector<T>& values) const {
-		if (node != nullptr) {
-			inOrder(node->left, values);
-			values.push_back(node->data);
-			inOrder(node->right, values);
+	void start() {
+#ifdef __linux__
+		for (int descriptor : descriptors) {
+			if (descriptor >= 0) {
+				ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
 		}
+#endif
 	}
 
-	friend std::ostream& operator<<(std::ostream& os, const BinaryTree& tree) {
-		tree.print(os, tree.root);
-		return os;
+	Values stop() {
+		Values values;
+		values.fill(-1);
+#ifdef __linux__
+		for (int i = 0; i < eventCount; ++i) {
+			if (descriptors[i] >= 0) {
+				ioctl(descriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+				long long value = 0;
+				if (read(descriptors[i], &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value))) {
+					values[i] = value;
+				}
+			}
+		}
+#endif
+		return values;
 	}
 
-	void print(std::ostream& os, Node* node) const {
-		if (node != nullptr) {
-			print(os, node->left);
-			os << node->data << " ";
-			print(os, node->right);
+	~HardwareCounters() {
+#ifdef __linux__
+		for (int descriptor : descriptors) {
+			if (descriptor >= 0) {
+				::close(descriptor);
+			}
 		}
+#endif
 	}
 
-	std::vector<T> getValues() const {
-		std::vector<T> values;
-		inOrder(root, values);
-		return values;
+private:
+	std::array<int, eventCount> descriptors;
+};
+
+// Набор замеров BinaryTree и конвейера для размеров 10, 100, ..., maxSize. Каждый замер
+// повторяется, пока суммарное время не достигнет minTime; время, число выделений памяти
+// и аппаратные счётчики учитываются только внутри probe.start()/probe.stop(), так что
+// подготовка данных и уничтожение деревьев в результат не попадают. Результаты
+// пишутся в JSON с постоянным набором полей, чтобы прогоны можно было сравнивать.
+class BenchmarkSuite {
+public:
+	struct Options {
+		size_t maxSize = 10000000;
+		double minTime = 0.2;     // Секунд измерений на каждый размер, но не более 10 * minTime вместе с подготовкой
+		double sizeBudget = 5.0;  // Если один прогон дольше, большие размеры пропускаются
+		uint64_t seed = 1;
+	};
+
+	class Probe {
+	public:
+		explicit Probe(HardwareCounters& counters) : counters(counters) {
+			totals.fill(0);
+		}
+
+		void start() {
+			allocationCounting.store(true, std::memory_order_relaxed);
+			allocationsAtStart = allocationCount.load(std::memory_order_relaxed);
+			bytesAtStart = allocationBytes.load(std::memory_order_relaxed);
+			counters.start();
+			startTime = std::chrono::steady_clock::now();
+		}
+
+		void stop() {
+			auto stopTime = std::chrono::steady_clock::now();
+			HardwareCounters::Values values = counters.stop();
+			seconds += std::chrono::duration<double>(stopTime - startTime).count();
+			allocations += allocationCount.load(std::memory_order_relaxed) - allocationsAtStart;
+			bytes += allocationBytes.load(std::memory_order_relaxed) - bytesAtStart;
+			allocationCounting.store(false, std::memory_order_relaxed);
+			for (int i = 0; i < HardwareCounters::eventCount; ++i) {
+				totals[i] = values[i] < 0 || totals[i] < 0 ? -1 : totals[i] + values[i];
+			}
+		}
+
+	private:
+		friend class BenchmarkSuite;
+
+		HardwareCounters& counters;
+		std::chrono::steady_clock::time_point startTime;
+		unsigned long long allocationsAtStart = 0, bytesAtStart = 0;
+		double seconds = 0;
+		unsigned long long allocations = 0, bytes = 0;
+		HardwareCounters::Values totals;
+	};
+
+	// Тело замера: готовит данные для размера n, выполняет измеряемую часть между
+	// probe.start() и probe.stop() и возвращает число выполненных операций
+	using Body = std::function<size_t(size_t n, Probe& probe)>;
+
+	explicit BenchmarkSuite(Options options) : options(options) {}
+
+	// limit ограничивает размер для замеров, которым большие размеры недоступны (0 - без ограничения)
+	void add(std::string name, std::string unit, Body body, size_t limit = 0) {
+		benchmarks.push_back({ std::move(name), std::move(unit), std::move(body), limit });
 	}
 
-	void setDebug(bool debug)
-	{
-		this->debug = debug;
+	void run(std::ostream& json) {
+		json << "{\n  \"seed\": " << options.seed << ",\n  \"max_size\": " << options.maxSize
+			<< ",\n  \"perf_events\": " << (counters.available() ? "true" : "false") << ",\n  \"results\": [";
+		bool first = true;
+		for (const Benchmark& benchmark : benchmarks) {
+			size_t maxSize = benchmark.limit != 0 ? std::min(benchmark.limit, options.maxSize) : options.maxSize;
+			for (size_t n = 10; n <= maxSize; n *= 10) {
+				Probe probe(counters);
+				size_t operations = 0;
+				long long iterations = 0;
+				double longest = 0;
+				auto started = std::chrono::steady_clock::now();
+				auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(); };
+				while (iterations == 0 || (probe.seconds < options.minTime && elapsed() < 10 * options.minTime)) {
+					double before = probe.seconds;
+					operations += benchmark.body(n, probe);
+					++iterations;
+					longest = std::max(longest, probe.seconds - before);
+				}
+				write(json, first, benchmark, n, iterations, operations, probe);
+				first = false;
+				if (longest > options.sizeBudget) {
+					break;
+				}
+			}
+		}
+		json << "\n  ]\n}\n";
 	}
 
-	~BinaryTree() {
-		if (debug)
-			std::cout << "Destructor" << std::endl;
+private:
+	struct Benchmark {
+		std::string name;
+		std::string unit;
+		Body body;
+		size_t limit;
+	};
 
-		clear(root);
+	Options options;
+	HardwareCounters counters;
+	std::vector<Benchmark> benchmarks;
+
+	void write(std::ostream& json, bool first, const Benchmark& benchmark, size_t n, long long iterations,
+		size_t operations, const Probe& probe) {
+		double perOperation = 1.0 / std::max<size_t>(operations, 1);
+		json << (first ? "" : ",") << "\n    { \"name\": \"" << benchmark.name << "\", \"size\": " << n
+			<< ", \"unit\": \"" << benchmark.unit << "\", \"iterations\": " << iterations
+			<< ", \"ops\": " << operations
+			<< ", \"ns_per_op\": " << probe.seconds * 1e9 * perOperation
+			<< ", \"allocs_per_op\": " << probe.allocations * perOperation
+			<< ", \"bytes_per_op\": " << probe.bytes * perOperation;
+		for (int i = 0; i < HardwareCounters::eventCount; ++i) {
+			json << ", \"" << HardwareCounters::names[i] << "_per_op\": ";
+			if (probe.totals[i] < 0) {
+				json << "null";
+			}
+			else {
+				json << probe.totals[i] * perOperation;
+			}
+		}
+		json << " }";
+
+		std::cout << std::left << std::setw(20) << benchmark.name << std::right << std::setw(10) << n
+			<< std::setw(14) << std::fixed << std::setprecision(1) << probe.seconds * 1e9 * perOperation << " ns/" << benchmark.unit
+			<< std::setw(10) << std::setprecision(2) << probe.allocations * perOperation << " allocs/" << benchmark.unit
+			<< std::defaultfloat << std::setprecision(6) << std::endl;
 	}
 };
 
-// Специализация std::hash для BinaryTree
-namespace std {
-	template <>
-	struct hash<BinaryTree<int>> {
-		size_t operator()(const BinaryTree<int>& tree) const {
-			size_t hashValue = 0;
-			std::vector<int> values = tree.getValues(); // Получаем значения дерева
+// Замеры BinaryTree<int> и потокового конвейера; JSON пишется в файл path
+int runBenchmarks(const std::string& path, size_t maxSize, uint64_t seed)
+{
+	using Tree = BinaryTree<int>;
 
-			for (const auto& value : values) {
-				hashValue ^= std::hash<int>()(value) + 0x9e3779b9 + (hashValue << 6) + (hashValue >> 2);
-			}
+	BenchmarkSuite::Options options;
+	options.maxSize = maxSize;
+	options.seed = seed;
+	BenchmarkSuite suite(options);
+
+	// Ключи деревьев - чётные числа 0..2n-2 в случайном порядке, промахи - нечётные
+	auto shuffledKeys = [seed](size_t n, int offset) {
+		std::vector<int> keys(n);
+		for (size_t i = 0; i < n; ++i) {
+			keys[i] = static_cast<int>(2 * i) + offset;
+		}
+		Xoshiro256 rng(seed ^ n);
+		for (size_t i = n; i > 1; --i) {
+			std::swap(keys[i - 1], keys[static_cast<size_t>(rng.next() % i)]);
+		}
+		return keys;
+	};
+	auto buildTree = [&](size_t n) {
+		Tree tree;
+		for (int key : shuffledKeys(n, 0)) {
+			tree.insert(key);
+		}
+		return tree;
+	};
+	volatile size_t sink = 0;
+	// Операции над деревом, стоимость которых не зависит от его размера, повторяются
+	const size_t repeats = 1000;
 
-			return hashValue;
+	suite.add("insert_random", "insert", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		std::vector<int> keys = shuffledKeys(n, 0);
+		Tree tree;
+		probe.start();
+		for (int key : keys) {
+			tree.insert(key);
+		}
+		probe.stop();
+		return n;
+		});
+	// Вставка по возрастанию и убыванию вырождает дерево в список: время O(n^2),
+	// поэтому размер ограничен
+	const size_t degenerateLimit = 10000;
+	suite.add("insert_sorted", "insert", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree;
+		probe.start();
+		for (size_t i = 0; i < n; ++i) {
+			tree.insert(static_cast<int>(i));
+		}
+		probe.stop();
+		return n;
+		}, degenerateLimit);
+	suite.add("insert_reverse", "insert", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree;
+		probe.start();
+		for (size_t i = n; i-- > 0;) {
+			tree.insert(static_cast<int>(i));
 		}
+		probe.stop();
+		return n;
+		}, degenerateLimit);
+	suite.add("insert_sorted_bulk", "insert", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		std::vector<int> keys(n);
+		std::iota(keys.begin(), keys.end(), 0);
+		Tree tree;
+		probe.start();
+		tree.insertSorted(keys.begin(), keys.end());
+		probe.stop();
+		return n;
+		});
+	// Строковые ключи: вставка перемещением и поиск по std::string_view без копий ключа
+	auto stringKeys = [&](size_t n) {
+		std::vector<std::string> keys;
+		keys.reserve(n);
+		for (int key : shuffledKeys(n, 0)) {
+			keys.push_back("key-" + std::to_string(key) + "-with-a-heap-allocated-suffix");
+		}
+		return keys;
 	};
+	using StringTree = BinaryTree<std::string, std::less<>>;
+	suite.add("insert_string", "insert", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		std::vector<std::string> keys = stringKeys(n);
+		StringTree tree;
+		probe.start();
+		for (std::string& key : keys) {
+			tree.insert(std::move(key));
+		}
+		probe.stop();
+		return n;
+		});
+	suite.add("find_string_view", "lookup", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		std::vector<std::string> keys = stringKeys(n);
+		StringTree tree;
+		for (const std::string& key : keys) {
+			tree.insert(key);
+		}
+		size_t found = 0;
+		probe.start();
+		for (const std::string& key : keys) {
+			found += tree.find(std::string_view(key)) != nullptr;
+		}
+		probe.stop();
+		sink = sink + found;
+		return n;
+		});
+	suite.add("search_hit", "lookup", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree = buildTree(n);
+		std::vector<int> probes = shuffledKeys(n, 0);
+		size_t found = 0;
+		probe.start();
+		for (int key : probes) {
+			found += tree.search(key);
+		}
+		probe.stop();
+		sink = sink + found;
+		return n;
+		});
+	suite.add("search_miss", "lookup", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree = buildTree(n);
+		std::vector<int> probes = shuffledKeys(n, 1);
+		size_t found = 0;
+		probe.start();
+		for (int key : probes) {
+			found += tree.search(key);
+		}
+		probe.stop();
+		sink = sink + found;
+		return n;
+		});
+	suite.add("get_values", "value", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree = buildTree(n);
+		probe.start();
+		std::vector<int> values = tree.getValues();
+		probe.stop();
+		sink = sink + values.size();
+		return n;
+		});
+	suite.add("copy_construct", "copy", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree = buildTree(n);
+		std::vector<Tree> copies;
+		copies.reserve(repeats);
+		probe.start();
+		for (size_t i = 0; i < repeats; ++i) {
+			copies.emplace_back(tree);
+		}
+		probe.stop();
+		return repeats;
+		});
+	suite.add("move_construct", "move", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree = buildTree(n);
+		probe.start();
+		for (size_t i = 0; i < repeats; ++i) {
+			Tree moved(std::move(tree));
+			tree = std::move(moved);
+		}
+		probe.stop();
+		return repeats;
+		});
+	suite.add("hash", "hash", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		Tree tree = buildTree(n);
+		size_t combined = 0;
+		probe.start();
+		for (size_t i = 0; i < repeats; ++i) {
+			combined ^= std::hash<Tree>{}(tree);
+		}
+		probe.stop();
+		sink = sink + combined;
+		return repeats;
+		});
+	// Дедупликация n случайных деревьев лабораторной (2-12 значений 0-99); все деревья
+	// создаются заранее, поэтому размер ограничен памятью
+	suite.add("unordered_set_dedup", "tree", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		std::vector<Tree> trees = RandomTreeGenerator(seed).generate(static_cast<int>(n));
+		std::unordered_set<Tree> unique;
+		probe.start();
+		for (const Tree& tree : trees) {
+			unique.insert(tree);
+		}
+		probe.stop();
+		sink = sink + unique.size();
+		return n;
+		}, 1000000);
+	suite.add("pipeline", "tree", [&](size_t n, BenchmarkSuite::Probe& probe) {
+		StreamingTreePipeline pipeline{ StreamingTreePipeline::Options() };
+		RandomTreeGenerator generator(seed);
+		size_t generated = 0;
+		probe.start();
+		StreamingTreePipeline::Result result = pipeline.run([&](Tree& tree) {
+			if (generated == n) {
+				return false;
+			}
+			tree = generator.tree(generated++);
+			return true;
+			}, nullptr);
+		probe.stop();
+		sink = sink + result.uniqueCount;
+		return n;
+		});
+
+	std::ofstream json(path);
+	if (!json) {
+		std::cout << "Cannot create " << path << std::endl;
+		return 1;
+	}
+	suite.run(json);
+	std::cout << "results: " << path << std::endl;
+	return 0;
 }
 
-int main()
+// Самопроверка операций BinaryTree, которые не использует конвейер: операции над
+// множествами, split/join, rangeScan и searchBatch сверяются с эталоном, посчитанным
+// по отсортированным массивам значений. Размеры деревьев покрывают пустое дерево,
+// массив small и деревья, на которых операции над множествами идут параллельно.
+// Затем проверяются нестандартный Compare, строковые ключи, BinaryMap, политики трассировки и сохранение
+// коллекции в файл с обратным чтением (файл check_trees.bin в текущем каталоге удаляется).
+// Возвращает 1, если хотя бы одна проверка не прошла.
+int runSelfCheck(uint64_t seed)
 {
-	// Инициализация генератора случайных чисел
-	srand(static_cast<unsigned int>(time(0)));
+	int failures = 0;
+	auto expect = [&failures](bool condition, const std::string& what) {
+		if (!condition) {
+			std::cout << "FAILED: " << what << std::endl;
+			++failures;
+		}
+		};
+	auto contains = [](const std::vector<int>& sorted, int value) {
+		return std::binary_search(sorted.begin(), sorted.end(), value);
+		};
 
-	// Генерация случайного размера вектора от 500 до 1000
-	int size = rand() % 501 + 500; // Случайное число от 500 до 1000
-	std::vector<BinaryTree<int>> v1(size);
+	Xoshiro256 rng(seed);
+	const int sizes[] = { 0, 1, 5, 8, 9, 300, 70000 };
+	for (int size : sizes) {
+		// Диапазон значений вдвое шире размера: есть и повторы внутри дерева, и общие ключи двух деревьев
+		RandomTreeGenerator::Options options;
+		options.treeSize = [size](Xoshiro256&) { return size; };
+		options.value = RandomTreeGenerator::uniform(0, 2 * size + 1);
+		RandomTreeGenerator generator(seed + static_cast<uint64_t>(size), options);
+		const BinaryTree<int> a = generator.tree(0);
+		const BinaryTree<int> b = generator.tree(1);
+		const std::vector<int> va = a.getValues();
+		const std::vector<int> vb = b.getValues();
+		const std::string label = " (size " + std::to_string(size) + ")";
+
+		auto checkResult = [&](const BinaryTree<int>& result, const std::vector<int>& reference, const std::string& what) {
+			BinaryTree<int> expected(reference.begin(), reference.end());
+			expect(result.getValues() == reference, what + label);
+			expect(result.getHash() == expected.getHash(), what + " hash" + label);
+		};
+
+		// Операции над множествами: копии равных ключей берутся из левого операнда
+		std::vector<int> onlyA, onlyB, common;
+		for (int value : va) {
+			(contains(vb, value) ? common : onlyA).push_back(value);
+		}
+		for (int value : vb) {
+			if (!contains(va, value)) {
+				onlyB.push_back(value);
+			}
+		}
+		std::vector<int> united;
+		std::merge(va.begin(), va.end(), onlyB.begin(), onlyB.end(), std::back_inserter(united));
+		checkResult(a.setUnion(b), united, "setUnion");
+		checkResult(a.setIntersection(b), common, "setIntersection");
+		checkResult(a.setDifference(b), onlyA, "setDifference");
+
+		// split по случайному ключу и обратный join
+		int key = rng.uniform(-1, 2 * size + 2);
+		auto parts = a.split(key);
+		auto middle = std::lower_bound(va.begin(), va.end(), key);
+		checkResult(parts.first, std::vector<int>(va.begin(), middle), "split less");
+		checkResult(parts.second, std::vector<int>(middle, va.end()), "split not less");
+		checkResult(BinaryTree<int>::join(parts.first, parts.second), va, "join");
+		if (parts.first.getSize() != 0 && parts.second.getSize() != 0) {
+			bool rejected = false;
+			try {
+				BinaryTree<int>::join(parts.second, parts.first);
+			}
+			catch (const std::invalid_argument&) {
+				rejected = true;
+			}
+			expect(rejected, "join of unordered trees" + label);
+		}
+
+		// rangeScan по случайному отрезку
+		int lo = rng.uniform(-1, 2 * size + 2);
+		int hi = rng.uniform(lo, 2 * size + 2);
+		std::vector<int> scanned;
+		a.rangeScan(lo, hi, [&scanned](int value) { scanned.push_back(value); });
+		expect(scanned == std::vector<int>(std::lower_bound(va.begin(), va.end(), lo), std::upper_bound(va.begin(), va.end(), hi)),
+			"rangeScan" + label);
+
+		// searchBatch по отсортированным ключам с попаданиями и промахами
+		std::vector<int> keys(static_cast<size_t>(size) + 16);
+		for (int& k : keys) {
+			k = rng.uniform(-1, 2 * size + 2);
+		}
+		std::sort(keys.begin(), keys.end());
+		std::vector<bool> found = a.searchBatch(keys);
+		bool batchOk = found.size() == keys.size();
+		for (size_t i = 0; batchOk && i < keys.size(); ++i) {
+			batchOk = found[i] == contains(va, keys[i]);
+		}
+		expect(batchOk, "searchBatch" + label);
+	}
+
+	// Обратный порядок: все операции, зависящие от порядка, должны идти через Compare
+	std::vector<int> values(300);
+	for (int& value : values) {
+		value = rng.uniform(0, 199);
+	}
+	BinaryTree<int, std::greater<int>> descending;
+	for (int value : values) {
+		descending.insert(value);
+	}
+	std::sort(values.begin(), values.end(), std::greater<int>());
+	expect(descending.getValues() == values, "std::greater insert order");
+	expect(descending.search(values.front()) && !descending.search(200), "std::greater search");
+	auto descendingParts = descending.split(100);
+	expect(descendingParts.first.getSize() == std::lower_bound(values.begin(), values.end(), 100, std::greater<int>()) - values.begin()
+		&& descendingParts.first.getValues().back() > 100, "std::greater split");
+	std::vector<int> scanned;
+	descending.rangeScan(150, 50, [&scanned](int value) { scanned.push_back(value); });
+	expect(scanned == std::vector<int>(std::lower_bound(values.begin(), values.end(), 150, std::greater<int>()),
+		std::upper_bound(values.begin(), values.end(), 50, std::greater<int>())), "std::greater rangeScan");
+
+	// Строковые ключи с прозрачным компаратором: поиск по std::string_view без временной строки
+	BinaryTree<std::string, std::less<>> words;
+	std::map<std::string, int> frequencies;
+	BinaryMap<std::string, int, std::less<>> counts;
+	for (int i = 0; i < 2000; ++i) {
+		std::string word = "w" + std::to_string(rng.uniform(0, 499));
+		frequencies[word]++;
+		counts[word]++;
+		words.insert(std::move(word));
+	}
+	expect(words.getSize() == 2000 && words.find(std::string_view(frequencies.begin()->first)) != nullptr
+		&& words.find(std::string_view("x")) == nullptr, "string tree find by string_view");
+	BinaryTree<std::string, std::less<>> wordsCopy = words;
+	wordsCopy.emplace(3, 'z');
+	expect(words.find("zzz") == nullptr && wordsCopy.find("zzz") != nullptr
+		&& std::hash<BinaryTree<std::string, std::less<>>>()(words) != std::hash<BinaryTree<std::string, std::less<>>>()(wordsCopy),
+		"string tree copy on write");
+
+	// BinaryMap сверяется с std::map; изменение копии не затрагивает оригинал
+	const auto& constCounts = counts;
+	bool mapOk = counts.getSize() == static_cast<int>(frequencies.size());
+	for (const auto& entry : frequencies) {
+		const int* count = constCounts.find(std::string_view(entry.first));
+		mapOk = mapOk && count != nullptr && *count == entry.second;
+	}
+	expect(mapOk, "BinaryMap counts");
+	BinaryMap<std::string, int, std::less<>> countsCopy = counts;
+	const std::string& firstWord = frequencies.begin()->first;
+	*countsCopy.find(std::string_view(firstWord)) = -1;
+	expect(!countsCopy.emplace(firstWord, 0) && countsCopy.contains(std::string_view(firstWord))
+		&& countsCopy["new"] == 0 && !counts.contains("new"), "BinaryMap emplace");
+	expect(counts[firstWord] == frequencies.begin()->second && countsCopy[firstWord] == -1, "BinaryMap copy on write");
+
+	// Политики трассировки: гистограмма CountingTrace учитывает каждый узел дерева, включая
+	// созданные переводом small в узлы и построением из отсортированного диапазона
+	using CountedTree = BinaryTree<int, std::less<int>, CountingTrace>;
+	auto histogramTotal = [] {
+		TreeStatsSnapshot stats = CountingTrace::snapshot();
+		return std::accumulate(stats.depthHistogram.begin(), stats.depthHistogram.end(), uint64_t(0));
+		};
+	CountingTrace::reset();
+	CountedTree counted;
+	for (int i = 0; i < 100; ++i) {
+		counted.insert(rng.uniform(0, 999));
+	}
+	expect(histogramTotal() == static_cast<uint64_t>(counted.getSize())
+		&& CountingTrace::snapshot().nodeAllocations == static_cast<uint64_t>(counted.getSize()), "CountingTrace inserts");
+	for (int i = 0; i < 50; ++i) {
+		counted.search(i);
+	}
+	CountedTree countedCopy = counted;
+	TreeStatsSnapshot stats = CountingTrace::snapshot();
+	expect(stats.searches == 50 && stats.searchComparisons >= stats.searches && stats.copies == 1, "CountingTrace searches and copies");
+	CountingTrace::reset();
+	std::vector<int> sortedValues(1000);
+	std::iota(sortedValues.begin(), sortedValues.end(), 0);
+	CountedTree bulk(sortedValues.begin(), sortedValues.end());
+	expect(histogramTotal() == static_cast<uint64_t>(bulk.getSize()), "CountingTrace bulk build");
+	CountingTrace::reset();
+	bulk.insertSorted(sortedValues.begin(), sortedValues.end());
+	expect(histogramTotal() == static_cast<uint64_t>(bulk.getSize()), "CountingTrace insertSorted");
 
-	// Заполнение вектора случайными значениями
-	for (int i = 0; i < size; ++i) {
-		BinaryTree<int> tree;
-		tree.setDebug(false);
+	// LogTrace печатает имена вызванных методов
+	std::ostringstream log;
+	std::streambuf* previous = std::cout.rdbuf(log.rdbuf());
+	{
+		BinaryTree<int, std::less<int>, LogTrace> logged;
+		logged.insert(1);
+		logged.search(1);
+	}
+	std::cout.rdbuf(previous);
+	expect(log.str() == "insert\nsearch\nDestructor\n", "LogTrace events");
 
-		int size_tree = rand() % 11 + 2; // Случайное число от 2 до 10
-		for (int j = 0; j < size_tree; ++j) { // Заполняем каждое дерево 10 случайными значениями
-			tree.insert(rand() % 100); // Случайное значение от 0 до 99
+	// Сохранение коллекции в файл и чтение через отображение в память
+	const std::string path = "check_trees.bin";
+	std::vector<BinaryTree<int>> saved = RandomTreeGenerator(seed).generate(500);
+	saved.emplace_back();
+	saveTrees(path, saved);
+	{
+		FrozenTreeCollection<int> frozen(path);
+		bool frozenOk = frozen.size() == saved.size();
+		for (size_t i = 0; frozenOk && i < saved.size(); ++i) {
+			FrozenTreeView<int> view = frozen[i];
+			std::vector<int> treeValues = saved[i].getValues();
+			frozenOk = view.getSize() == saved[i].getSize() && std::equal(view.begin(), view.end(), treeValues.begin(), treeValues.end())
+				&& std::all_of(treeValues.begin(), treeValues.end(), [&view](int value) { return view.search(value); })
+				&& !view.search(-1) && view.toTree() == saved[i] && view.toTree().getHash() == saved[i].getHash();
 		}
-		v1[i] = std::move(tree); // Перемещение дерева в вектор
+		expect(frozenOk, "frozen tree views");
+		expect(frozen.load() == saved, "frozen collection load");
+	}
+	saveTree(path, descending);
+	{
+		FrozenTreeCollection<int, std::greater<int>> frozen(path);
+		expect(frozen.size() == 1 && frozen[0].search(values.front()) && frozen[0].search(values.back()) && !frozen[0].search(200)
+			&& frozen[0].toTree().search(values.back()) && frozen.load().front() == descending, "frozen std::greater tree");
 	}
+	std::remove(path.c_str());
+
+	std::cout << (failures == 0 ? "self-check passed" : "self-check failed") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 2 && std::string(argv[1]) == "concurrent")
+		return benchmarkConcurrentTree();
+
+	// bench [результат.json] [наибольший размер] [зерно]
+	if (argc >= 2 && std::string(argv[1]) == "bench")
+		return runBenchmarks(argc >= 3 ? argv[2] : "bench.json", argc >= 4 ? std::stoull(argv[3]) : 10000000,
+			argc >= 5 ? std::stoull(argv[4]) : 1);
+
+	// check [зерно]
+	if (argc >= 2 && std::string(argv[1]) == "check")
+		return runSelfCheck(argc >= 3 ? std::stoull(argv[2]) : 1);
+
+	// Зерно задаётся последним аргументом; без него берётся текущее время и печатается,
+	// чтобы прогон можно было повторить
+	bool streaming = argc >= 2 && std::string(argv[1]) == "stream";
+	int seedArgument = streaming ? 3 : 1;
+	uint64_t seed = argc > seedArgument ? std::stoull(argv[seedArgument])
+		: static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+	std::cout << "seed: " << seed << std::endl;
+
+	if (streaming)
+		return runStreamingPipeline(argc >= 3 ? std::stoll(argv[2]) : 1000000, seed);
+
+	Xoshiro256 rng(seed);
+	RandomTreeGenerator generator(seed);
+
+	// Генерация случайного размера вектора от 500 до 1000
+	int size = rng.uniform(500, 1000);
+
+	// Заполнение вектора деревьями из 2-12 случайных значений от 0 до 99
+	std::vector<BinaryTree<int>> v1 = generator.generate(size);
 
 	// Определение позиций b и e
 	int b = size - 200; // Начальная позиция (последние 200 элементов)
@@ -245,34 +2979,30 @@ int main()
 	std::vector<BinaryTree<int>> v2(v1.begin() + b, v1.begin() + e + 1);
 
 	// Определение n в диапазоне от 20 до 50
-	int n1 = rand() % 31 + 20; // Случайное число от 20 до 50
+	int n1 = rng.uniform(20, 50); // Случайное число от 20 до 50
 
-	// Сортировка вектора v1 по размеру деревьев
-	std::sort(v1.begin(), v1.end(), [](const BinaryTree<int>& a, const BinaryTree<int>& b) {
-		return a > b; // Сравнение по размеру
-		});
+	// Отбор n наибольших деревьев v1 без сортировки всего вектора
+	TreeRanking ranking;
+	const std::vector<uint32_t>& largest = ranking.select(v1, n1, TreeRanking::Order::Largest);
 
-	// Создание списка list1 и добавление первых n наибольших деревьев
-	std::list<BinaryTree<int>> list1;
-	for (int i = 0; i < n1 && i < v1.size(); ++i) {
-		list1.push_back(std::move(v1[i])); // Перемещение деревьев в список
+	// Создание list1 и добавление первых n наибольших деревьев
+	std::vector<BinaryTree<int>> list1;
+	list1.reserve(largest.size());
+	for (uint32_t index : largest) {
+		list1.push_back(std::move(v1[index])); // Перемещение деревьев в список
 	}
+	eraseIndices(v1, largest); // Удаляем перемещённые элементы из v1
 
-	int n2 = rand() % 31 + 20; // Случайное число от 20 до 50
+	int n2 = rng.uniform(20, 50); // Случайное число от 20 до 50
 
-	// Использование partial_sort для нахождения n наименьших деревьев
-	std::partial_sort(v2.begin(), v2.begin() + n2, v2.end(), [](const BinaryTree<int>& a, const BinaryTree<int>& b) {
-		return a < b; // Сравнение по размеру
-		});
-
-	// Создание списка list2 и добавление первых n наименьших деревьев
-	std::list<BinaryTree<int>> list2(v2.begin(), v2.begin() + n2);
-
-	// Удаление перемещенных элементов из векторов v1 и v2
-	v1.erase(v1.begin(), v1.begin() + n1); // Удаляем элементы из v1
-	v1.shrink_to_fit();
-	v2.erase(v2.begin(), v2.begin() + n2); // Удаляем элементы из v2
-	v2.shrink_to_fit();
+	// Отбор n наименьших деревьев v2 и их перемещение в list2
+	const std::vector<uint32_t>& smallest = ranking.select(v2, n2, TreeRanking::Order::Smallest);
+	std::vector<BinaryTree<int>> list2;
+	list2.reserve(smallest.size());
+	for (uint32_t index : smallest) {
+		list2.push_back(std::move(v2[index]));
+	}
+	eraseIndices(v2, smallest);
 
 	// 1. Вычисление среднего значения
 	int totalSize = 0;
@@ -281,73 +3011,39 @@ int main()
 	}
 	double averageSize = static_cast<double>(totalSize) / list1.size(); // Среднее значение
 
-	// 2. Перегруппировка элементов списка
-	std::list<BinaryTree<int>> greaterThanAverage;
-	std::list<BinaryTree<int>> lessThanOrEqualToAverage;
-
-	for (const auto& tree : list1) {
-		if (tree.getSize() > averageSize) {
-			greaterThanAverage.push_back(tree); // Дерево больше среднего
-		}
-		else {
-			lessThanOrEqualToAverage.push_back(tree); // Дерево меньше или равно среднему
-		}
-	}
-
-	// Объединяем списки: сначала элементы больше среднего, затем остальные
-	greaterThanAverage.splice(greaterThanAverage.end(), lessThanOrEqualToAverage);
-
-	// Теперь greaterThanAverage содержит все деревья, большие среднего значения, в начале
-	list1 = std::move(greaterThanAverage); // Перемещаем обратно в list1
+	// 2. Перегруппировка: сначала деревья больше среднего, затем остальные, порядок внутри групп сохраняется
+	std::vector<BinaryTree<int>> scratch;
+	scratch.reserve(list1.size());
+	stablePartition(list1, [averageSize](const BinaryTree<int>& tree) {
+		return tree.getSize() > averageSize;
+		}, scratch);
 
-	// 1. Удаление элементов с нечётным размером
-	list2.remove_if([](const BinaryTree<int>& tree) {
+	// 3. Удаление элементов с нечётным размером
+	list2.erase(std::remove_if(list2.begin(), list2.end(), [](const BinaryTree<int>& tree) {
 		return  (tree.getSize() % 2 != 0); // Условие для удаления
-		});
-
-	std::unordered_set< BinaryTree<int>> unique_tree;
-
-	for (const auto& tree : v1)
-	{
-		unique_tree.insert(tree);
-	}
-
-	for (const auto& tree : v2)
-	{
-		unique_tree.insert(tree);
-	}
+		}), list2.end());
 
-	std::vector< BinaryTree<int>> v3(unique_tree.begin(), unique_tree.end());
-
-	// 1. Определяем размеры списков
-	size_t size1 = list1.size();
-	size_t size2 = list2.size();
-
-	// 2. Находим количество элементов, которые нужно удалить
-	size_t n = 0; // Установите n в нужное значение
-	if (size1 > size2) {
-		n = size1 - size2; // Удаляем из list1
-		auto it = list1.begin();
-		std::advance(it, n); // Перемещаем итератор на n позиций вперед
-		list1.erase(list1.begin(), it); // Удаляем первые n элементов
-	}
-	else if (size2 > size1) {
-		n = size2 - size1; // Удаляем из list2
-		auto it = list2.begin();
-		std::advance(it, n); // Перемещаем итератор на n позиций вперед
-		list2.erase(list2.begin(), it); // Удаляем первые n элементов
+	// 4. Уникальные деревья из v1 и v2
+	size_t tableSize = 1;
+	while (tableSize < 2 * (v1.size() + v2.size())) {
+		tableSize *= 2;
 	}
+	std::vector<uint32_t> table(tableSize, 0);
+	std::vector< BinaryTree<int>> v3;
+	v3.reserve(v1.size() + v2.size());
+	appendUnique(v1, v3, table);
+	appendUnique(v2, v3, table);
 
-	// 3. Создаем список list3 для хранения пар
-	std::list<std::pair<BinaryTree<int>, BinaryTree<int>>> list3;
+	// 5. Пары из list1 и list2: у более длинного списка пропускаются первые элементы,
+	// чтобы длины совпали
+	size_t pairs = std::min(list1.size(), list2.size());
+	size_t skip1 = list1.size() - pairs;
+	size_t skip2 = list2.size() - pairs;
 
-	// 4. Формируем пары из элементов list1 и list2
-	auto it1 = list1.begin();
-	auto it2 = list2.begin();
-	while (it1 != list1.end() && it2 != list2.end()) {
-		list3.emplace_back(*it1, *it2); // Добавляем пару в list3
-		++it1;
-		++it2;
+	std::vector<std::pair<BinaryTree<int>, BinaryTree<int>>> list3;
+	list3.reserve(pairs);
+	for (size_t i = 0; i < pairs; ++i) {
+		list3.emplace_back(std::move(list1[skip1 + i]), std::move(list2[skip2 + i]));
 	}
 
 	// Создание вектора для хранения пар
@@ -355,10 +3051,13 @@ int main()
 
 	// Определяем минимальный размер между v1 и v2
 	size_t minSize = std::min(v1.size(), v2.size());
+	v4.reserve(minSize);
 
 	// Формируем пары из элементов v1 и v2
 	for (size_t i = 0; i < minSize; ++i) {
-		v4.emplace_back(v1[i], v2[i]); // Добавляем пару в v3
+		v4.emplace_back(std::move(v1[i]), std::move(v2[i])); // Добавляем пару в v4
 	}
+
+	return 0;
 }
 
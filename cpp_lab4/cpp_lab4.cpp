@@ -3,6 +3,439 @@
 #include <cmath>
 #include <iterator>
 #include <functional>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <fstream>
+#include <future>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <optional>
+#include <limits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Cannot open file " + path);
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length != 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            bytes = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        }
+#else
+        descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::runtime_error("Cannot open file " + path);
+        }
+        struct stat info;
+        fstat(descriptor, &info);
+        length = static_cast<size_t>(info.st_size);
+        if (length != 0) {
+            void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            bytes = address == MAP_FAILED ? nullptr : static_cast<const char*>(address);
+        }
+#endif
+        if (length != 0 && bytes == nullptr) {
+            close();
+            throw std::runtime_error("Cannot map file " + path);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // Подкачивает страницы диапазона: подсказка системе и чтение по байту со страницы
+    void prefetch(size_t offset, size_t count) const {
+        size_t begin, end;
+        if (!pageRange(offset, count, begin, end)) {
+            return;
+        }
+#ifndef _WIN32
+        madvise(const_cast<char*>(bytes) + begin, end - begin, MADV_WILLNEED);
+#endif
+        volatile char sink = 0;
+        for (size_t page = begin; page < end; page += pageSize()) {
+            sink = sink + bytes[page];
+        }
+    }
+
+    // Освобождает страницы диапазона из рабочего набора процесса; данные остаются в файле
+    void release(size_t offset, size_t count) const {
+        size_t begin, end;
+        if (!pageRange(offset, count, begin, end)) {
+            return;
+        }
+#ifdef _WIN32
+        VirtualUnlock(const_cast<char*>(bytes) + begin, end - begin);
+#else
+        madvise(const_cast<char*>(bytes) + begin, end - begin, MADV_DONTNEED);
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int descriptor = -1;
+#endif
+
+    static size_t pageSize() {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        static const size_t page = info.dwPageSize;
+#else
+        static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+        return page;
+    }
+
+    bool pageRange(size_t offset, size_t count, size_t& begin, size_t& end) const {
+        if (count == 0 || offset >= length) {
+            return false;
+        }
+        begin = offset / pageSize() * pageSize();
+        end = std::min(length, offset + count);
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes != nullptr) {
+            UnmapViewOfFile(bytes);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+#else
+        if (bytes != nullptr) {
+            munmap(const_cast<char*>(bytes), length);
+        }
+        if (descriptor >= 0) {
+            ::close(descriptor);
+        }
+#endif
+        bytes = nullptr;
+    }
+};
+
+// Двоичный формат сжатой построчной матрицы (CSR, порядок байт платформы):
+//   заголовок MatrixFileHeader;
+//   MatrixEntry<T> entries[nonZeros] - элементы по строкам, в строке по возрастанию столбца;
+//   uint64_t rowOffsets[rows + 1] - начало каждой строки в entries.
+// Таблица строк записывается последней, поэтому файл строится построчно без
+// хранения всей матрицы в памяти (CompressedMatrixWriter).
+struct MatrixFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t valueSize;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t nonZeros;
+};
+
+template<typename T>
+struct MatrixEntry {
+    uint64_t col;
+    T value;
+};
+
+constexpr char matrixFileMagic[8] = { 'S', 'P', 'M', 'C', 'S', 'R', '\0', '\0' };
+constexpr uint32_t matrixFileVersion = 1;
+
+// Построчная запись матрицы в файл формата MatrixFileHeader
+template<typename T>
+class CompressedMatrixWriter {
+    static_assert(std::is_trivially_copyable<T>::value, "Matrix files support only trivially copyable values");
+
+public:
+    CompressedMatrixWriter(const std::string& path, size_t rows, size_t cols)
+        : output(path, std::ios::binary | std::ios::trunc), rows(rows), cols(cols) {
+        // Таблица из rows + 1 смещений должна поместиться в файл и в адресное пространство читателя
+        if (rows >= std::numeric_limits<size_t>::max() / sizeof(uint64_t)) {
+            throw std::length_error("Too many rows for a matrix file.");
+        }
+        if (!output) {
+            throw std::runtime_error("Cannot create file " + path);
+        }
+        MatrixFileHeader header{};
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header)); // Заполняется в finish()
+        rowOffsets.reserve(rows + 1);
+        rowOffsets.push_back(0);
+    }
+
+    CompressedMatrixWriter(const CompressedMatrixWriter&) = delete;
+    CompressedMatrixWriter& operator=(const CompressedMatrixWriter&) = delete;
+
+    // Дописывает следующую строку: пары (столбец, значение) в любом порядке
+    void appendRow(std::vector<std::pair<size_t, T>> row) {
+        if (rowOffsets.size() > rows) {
+            throw std::out_of_range("All rows have already been written.");
+        }
+        std::sort(row.begin(), row.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& [col, value] : row) {
+            if (col >= cols) {
+                throw std::out_of_range("Column index is out of range.");
+            }
+            MatrixEntry<T> entry{};
+            entry.col = col;
+            entry.value = value;
+            output.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        }
+        rowOffsets.push_back(rowOffsets.back() + row.size());
+    }
+
+    // Дописывает пустые оставшиеся строки, таблицу строк и заголовок
+    void finish() {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        rowOffsets.resize(rows + 1, rowOffsets.back());
+        output.write(reinterpret_cast<const char*>(rowOffsets.data()), rowOffsets.size() * sizeof(uint64_t));
+
+        MatrixFileHeader header{};
+        std::memcpy(header.magic, matrixFileMagic, sizeof(header.magic));
+        header.version = matrixFileVersion;
+        header.valueSize = sizeof(T);
+        header.rows = rows;
+        header.cols = cols;
+        header.nonZeros = rowOffsets.back();
+        output.seekp(0);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.close();
+        if (!output) {
+            throw std::runtime_error("Cannot write matrix file.");
+        }
+    }
+
+    ~CompressedMatrixWriter() {
+        try {
+            finish();
+        }
+        catch (const std::exception&) {
+        }
+    }
+
+private:
+    std::ofstream output;
+    size_t rows, cols;
+    std::vector<uint64_t> rowOffsets;
+    bool finished = false;
+};
+
+// Обратная перестановка: inverse[perm[i]] = i
+inline std::vector<size_t> inversePermutation(const std::vector<size_t>& perm) {
+    std::vector<size_t> inverse(perm.size(), perm.size());
+    for (size_t i = 0; i < perm.size(); ++i) {
+        if (perm[i] >= perm.size() || inverse[perm[i]] != perm.size()) {
+            throw std::invalid_argument("Not a permutation.");
+        }
+        inverse[perm[i]] = i;
+    }
+    return inverse;
+}
+
+// Перенумерации вершин графа разреженности, улучшающие локальность обращений к вектору.
+// Все методы возвращают перестановку perm, где perm[новый индекс] = старый индекс.
+class GraphOrdering {
+public:
+    using Adjacency = std::vector<std::vector<size_t>>;
+
+    explicit GraphOrdering(Adjacency adjacency)
+        : adjacency(std::move(adjacency)), part(this->adjacency.size(), 0), visited(this->adjacency.size(), 0) {}
+
+    // Обратный алгоритм Катхилла-Макки: уменьшает ширину ленты и заполнение при исключении
+    std::vector<size_t> reverseCuthillMcKee() {
+        std::vector<size_t> order;
+        order.reserve(adjacency.size());
+        resetParts();
+        for (size_t start : byDegree()) {
+            if (part[start] != 0) {
+                continue;
+            }
+            LevelStructure levels = breadthFirst(peripheralNode(start, 0), 0, true);
+            for (size_t node : levels.order) {
+                part[node] = 1; // Компонента обработана
+            }
+            order.insert(order.end(), levels.order.begin(), levels.order.end());
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    // Вершины по убыванию степени: строки-"хабы" степенных графов оказываются рядом
+    std::vector<size_t> degreeOrdering() const {
+        std::vector<size_t> order = byDegree();
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    // Рекурсивная бисекция по уровням обхода в ширину: каждая часть размером до blockSize
+    // получает непрерывный диапазон индексов, и её участок вектора помещается в кэш
+    std::vector<size_t> partitionOrdering(size_t blockSize = 256) {
+        if (blockSize == 0) {
+            throw std::invalid_argument("Block size must be positive.");
+        }
+        std::vector<size_t> nodes(adjacency.size());
+        std::iota(nodes.begin(), nodes.end(), size_t(0));
+        std::vector<size_t> order;
+        order.reserve(adjacency.size());
+        resetParts();
+        bisect(nodes, 0, blockSize, order);
+        return order;
+    }
+
+private:
+    struct LevelStructure {
+        std::vector<size_t> order;
+        size_t depth = 0;
+        size_t lastLevel = 0; // Начало последнего уровня в order
+    };
+
+    Adjacency adjacency;
+    std::vector<size_t> part;    // Номер части, которой принадлежит вершина
+    std::vector<size_t> visited; // Метка обхода, чтобы не очищать массив между обходами
+    size_t epoch = 0;
+    size_t parts = 0;
+
+    void resetParts() {
+        std::fill(part.begin(), part.end(), 0);
+        parts = 0;
+    }
+
+    std::vector<size_t> byDegree() const {
+        std::vector<size_t> order(adjacency.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return adjacency[a].size() < adjacency[b].size();
+        });
+        return order;
+    }
+
+    // Обход в ширину по вершинам части id; соседи внутри уровня при необходимости по возрастанию степени
+    LevelStructure breadthFirst(size_t root, size_t id, bool sortByDegree) {
+        LevelStructure levels;
+        ++epoch;
+        visited[root] = epoch;
+        levels.order.push_back(root);
+        size_t levelBegin = 0;
+        while (levelBegin < levels.order.size()) {
+            size_t levelEnd = levels.order.size();
+            levels.lastLevel = levelBegin;
+            ++levels.depth;
+            for (size_t i = levelBegin; i < levelEnd; ++i) {
+                size_t first = levels.order.size();
+                for (size_t next : adjacency[levels.order[i]]) {
+                    if (part[next] == id && visited[next] != epoch) {
+                        visited[next] = epoch;
+                        levels.order.push_back(next);
+                    }
+                }
+                if (sortByDegree) {
+                    std::sort(levels.order.begin() + first, levels.order.end(), [this](size_t a, size_t b) {
+                        return adjacency[a].size() < adjacency[b].size();
+                    });
+                }
+            }
+            levelBegin = levelEnd;
+        }
+        return levels;
+    }
+
+    // Псевдопериферийная вершина (Гиббс-Пул-Стокмейер): пока глубина обхода растёт,
+    // переходим к вершине наименьшей степени на последнем уровне
+    size_t peripheralNode(size_t root, size_t id) {
+        LevelStructure levels = breadthFirst(root, id, false);
+        while (true) {
+            size_t candidate = levels.order[levels.lastLevel];
+            for (size_t i = levels.lastLevel; i < levels.order.size(); ++i) {
+                if (adjacency[levels.order[i]].size() < adjacency[candidate].size()) {
+                    candidate = levels.order[i];
+                }
+            }
+            LevelStructure next = breadthFirst(candidate, id, false);
+            if (next.depth <= levels.depth) {
+                return root;
+            }
+            root = candidate;
+            levels = std::move(next);
+        }
+    }
+
+    void bisect(const std::vector<size_t>& nodes, size_t id, size_t blockSize, std::vector<size_t>& order) {
+        // Обход всех компонент части подряд: вершины одной компоненты остаются рядом.
+        // Вложенные части обходятся от первой вершины в порядке родителя, то есть от
+        // границы разреза, поэтому соседние части примыкают друг к другу
+        std::vector<size_t> sequence;
+        sequence.reserve(nodes.size());
+        size_t component = ++parts;
+        for (size_t start : nodes) {
+            if (part[start] != id) {
+                continue;
+            }
+            LevelStructure levels = breadthFirst(id == 0 ? peripheralNode(start, id) : start, id, false);
+            for (size_t node : levels.order) {
+                part[node] = component;
+            }
+            sequence.insert(sequence.end(), levels.order.begin(), levels.order.end());
+        }
+        if (sequence.size() <= blockSize) {
+            order.insert(order.end(), sequence.begin(), sequence.end());
+            return;
+        }
+        size_t half = sequence.size() / 2;
+        std::vector<size_t> first(sequence.begin(), sequence.begin() + half);
+        std::vector<size_t> second(sequence.begin() + half, sequence.end());
+        size_t firstId = ++parts, secondId = ++parts;
+        for (size_t node : first) {
+            part[node] = firstId;
+        }
+        for (size_t node : second) {
+            part[node] = secondId;
+        }
+        bisect(first, firstId, blockSize, order);
+        bisect(second, secondId, blockSize, order);
+    }
+};
 
 template<typename T>
 class SparseVector {
@@ -17,6 +450,12 @@ public:
         return data[index];
     }
 
+    // Чтение без вставки: отсутствующий элемент считается нулём
+    T at(size_t index) const {
+        auto it = data.find(index);
+        return it == data.end() ? T(0) : it->second;
+    }
+
     size_t getSize() const {
         return size;
     }
@@ -61,6 +500,29 @@ public:
         return result;
     }
 
+    // Перестановка: perm[новый индекс] = старый индекс
+    SparseVector<T> permute(const std::vector<size_t>& perm) const {
+        return remap(inversePermutation(perm));
+    }
+
+    // Обратная перестановка: возвращает вектор к исходной нумерации
+    SparseVector<T> unpermute(const std::vector<size_t>& perm) const {
+        return remap(perm);
+    }
+
+private:
+    SparseVector<T> remap(const std::vector<size_t>& target) const {
+        if (target.size() != size) {
+            throw std::invalid_argument("Permutation size must match the vector size.");
+        }
+        SparseVector<T> result(size);
+        result.data.reserve(data.size());
+        for (const auto& [index, value] : data) {
+            result.data.emplace(target[index], value);
+        }
+        return result;
+    }
+
 };
 
 template<typename T>
@@ -72,6 +534,32 @@ std::ostream& operator<<(std::ostream& os, const SparseVector<T>& vec) {
 }
 
 
+// Структурные характеристики матрицы, по которым выбираются алгоритмы
+struct MatrixStatistics {
+    size_t nonZeros = 0;
+    size_t maxRowNonZeros = 0;
+    // rowHistogram[0] - пустые строки, rowHistogram[b] - строки с числом ненулевых в [2^(b-1), 2^b)
+    std::vector<size_t> rowHistogram;
+    size_t bandwidth = 0;
+    bool symmetric = true;
+    bool diagonallyDominant = true; // Строгое диагональное преобладание по строкам
+    double norm1 = 0;               // Максимальная сумма модулей по столбцам
+    double normInf = 0;             // Максимальная сумма модулей по строкам
+    double frobenius = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const MatrixStatistics& stats) {
+    os << "nnz: " << stats.nonZeros << ", max row nnz: " << stats.maxRowNonZeros
+        << ", bandwidth: " << stats.bandwidth << ", symmetric: " << (stats.symmetric ? "yes" : "no")
+        << ", diagonally dominant: " << (stats.diagonallyDominant ? "yes" : "no")
+        << ", norm1: " << stats.norm1 << ", normInf: " << stats.normInf << ", frobenius: " << stats.frobenius
+        << ", rows by nnz:";
+    for (size_t count : stats.rowHistogram) {
+        os << " " << count;
+    }
+    return os;
+}
+
 template<typename T>
 class SparseMatrix {
 
@@ -81,14 +569,296 @@ class SparseMatrix {
 private:
     std::unordered_map<std::pair<size_t, size_t>, T, std::hash<std::pair<size_t, size_t>>> data;
     size_t rows, cols;
+    mutable std::optional<MatrixStatistics> cachedStatistics; // Сбрасывается при любой записи
+
+    static SparseMatrix<T> identity(size_t n) {
+        SparseMatrix<T> result(n, n);
+        for (size_t i = 0; i < n; ++i) {
+            result.data[{i, i}] = 1;
+        }
+        return result;
+    }
+
+    // Строки матрицы списками (столбец, значение)
+    std::vector<std::vector<std::pair<size_t, T>>> rowLists() const {
+        std::vector<std::vector<std::pair<size_t, T>>> result(rows);
+        for (const auto& [key, value] : data) {
+            if (value != T(0)) {
+                result[key.first].emplace_back(key.second, value);
+            }
+        }
+        return result;
+    }
+
+    std::vector<T> multiplyDense(const std::vector<T>& vec, bool transposed) const {
+        std::vector<T> result(transposed ? cols : rows);
+        for (const auto& [key, value] : data) {
+            if (transposed) {
+                result[key.second] += value * vec[key.first];
+            }
+            else {
+                result[key.first] += value * vec[key.second];
+            }
+        }
+        return result;
+    }
+
+    // Оценка 1-нормы оператора по алгоритму Хейджера-Хайэма (LAPACK xLACON):
+    // несколько умножений на вектор вместо построения матрицы оператора
+    static double estimateNorm1(size_t n, const std::function<std::vector<T>(const std::vector<T>&)>& apply,
+                                const std::function<std::vector<T>(const std::vector<T>&)>& applyTransposed) {
+        if (n == 0) {
+            return 0;
+        }
+        auto norm1 = [](const std::vector<T>& vec) {
+            double sum = 0;
+            for (const T& value : vec) {
+                sum += std::abs(value);
+            }
+            return sum;
+        };
+        std::vector<T> x(n, T(1) / static_cast<T>(n));
+        double estimate = 0;
+        size_t previous = n;
+        for (int iteration = 0; iteration < 5; ++iteration) {
+            std::vector<T> y = apply(x);
+            estimate = std::max(estimate, norm1(y));
+            for (T& value : y) {
+                value = value < T(0) ? T(-1) : T(1);
+            }
+            std::vector<T> z = applyTransposed(y);
+            size_t best = 0;
+            T dot = 0;
+            for (size_t i = 0; i < n; ++i) {
+                dot += z[i] * x[i];
+                if (std::abs(z[i]) > std::abs(z[best])) {
+                    best = i;
+                }
+            }
+            if (iteration > 0 && (std::abs(z[best]) <= dot || best == previous)) {
+                break;
+            }
+            previous = best;
+            std::fill(x.begin(), x.end(), T(0));
+            x[best] = 1;
+        }
+        // Знакопеременный вектор Хайэма страхует от недооценки на особых структурах
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = static_cast<T>((i % 2 ? -1.0 : 1.0) * (1.0 + (n > 1 ? double(i) / (n - 1) : 0.0)));
+        }
+        return std::max(estimate, 2 * norm1(apply(x)) / (3 * n));
+    }
+
+    // Узлы и веса квадратуры Гаусса-Лежандра порядка m на отрезке [0, 1]
+    static void gaussLegendre(int m, std::vector<double>& nodes, std::vector<double>& weights) {
+        const double pi = std::acos(-1.0);
+        nodes.resize(m);
+        weights.resize(m);
+        for (int i = 0; i < m; ++i) {
+            double x = std::cos(pi * (i + 0.75) / (m + 0.5)); // Начальное приближение к i-му корню P_m
+            double derivative = 1;
+            for (int iteration = 0; iteration < 100; ++iteration) {
+                double previous = 1, current = x;
+                for (int k = 2; k <= m; ++k) {
+                    double next = ((2 * k - 1) * x * current - (k - 1) * previous) / k;
+                    previous = current;
+                    current = next;
+                }
+                derivative = m * (x * current - previous) / (x * x - 1);
+                double step = current / derivative;
+                x -= step;
+                if (std::abs(step) < 1e-16) {
+                    break;
+                }
+            }
+            nodes[i] = (1 + x) / 2;
+            weights[i] = 1 / ((1 - x * x) * derivative * derivative);
+        }
+    }
+
+    // Собственное разложение симметричной матрицы циклическим методом Якоби: a (n x n по строкам)
+    // вращениями приводится к диагональному виду, vectors накапливает их произведение по столбцам
+    static void jacobiEigen(std::vector<double>& a, std::vector<double>& vectors, size_t n) {
+        vectors.assign(n * n, 0);
+        for (size_t i = 0; i < n; ++i) {
+            vectors[i * n + i] = 1;
+        }
+        const double epsilon = std::numeric_limits<double>::epsilon();
+        for (int sweep = 0; sweep < 100; ++sweep) {
+            double offDiagonal = 0, total = 0;
+            for (size_t i = 0; i < n * n; ++i) {
+                total += a[i] * a[i];
+                if (i / n != i % n) {
+                    offDiagonal += a[i] * a[i];
+                }
+            }
+            if (offDiagonal <= epsilon * epsilon * total) {
+                return;
+            }
+            for (size_t p = 0; p < n; ++p) {
+                for (size_t q = p + 1; q < n; ++q) {
+                    if (a[p * n + q] == 0) {
+                        continue;
+                    }
+                    double theta = (a[q * n + q] - a[p * n + p]) / (2 * a[p * n + q]);
+                    double t = (theta < 0 ? -1.0 : 1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                    double c = 1 / std::sqrt(t * t + 1), s = t * c;
+                    for (size_t k = 0; k < n; ++k) {
+                        double kp = a[k * n + p], kq = a[k * n + q];
+                        a[k * n + p] = c * kp - s * kq;
+                        a[k * n + q] = s * kp + c * kq;
+                    }
+                    for (size_t k = 0; k < n; ++k) {
+                        double pk = a[p * n + k], qk = a[q * n + k];
+                        a[p * n + k] = c * pk - s * qk;
+                        a[q * n + k] = s * pk + c * qk;
+                    }
+                    for (size_t k = 0; k < n; ++k) {
+                        double kp = vectors[k * n + p], kq = vectors[k * n + q];
+                        vectors[k * n + p] = c * kp - s * kq;
+                        vectors[k * n + q] = s * kp + c * kq;
+                    }
+                }
+            }
+        }
+    }
+
+    // f(A) = V diag(f(lambda)) V^T для симметричной (или диагональной) матрицы.
+    // Элементы на уровне ошибок округления отбрасываются, чтобы не терять разреженность
+    SparseMatrix<T> spectralFunction(const std::function<double(double)>& f) const {
+        SparseMatrix<T> result(rows, cols);
+        if (statistics().bandwidth == 0) {
+            for (size_t i = 0; i < rows; ++i) {
+                T value = static_cast<T>(f(static_cast<double>(at(i, i))));
+                if (value != T(0)) {
+                    result.data.emplace(std::make_pair(i, i), value);
+                }
+            }
+            return result;
+        }
+
+        const size_t n = rows;
+        std::vector<double> a(n * n), vectors;
+        for (const auto& [key, value] : data) {
+            a[key.first * n + key.second] = static_cast<double>(value);
+        }
+        jacobiEigen(a, vectors, n);
+        std::vector<double> values(n);
+        for (size_t k = 0; k < n; ++k) {
+            values[k] = f(a[k * n + k]);
+        }
+
+        std::vector<double> dense(n * n);
+        double largest = 0;
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = i; j < n; ++j) {
+                double sum = 0;
+                for (size_t k = 0; k < n; ++k) {
+                    sum += vectors[i * n + k] * values[k] * vectors[j * n + k];
+                }
+                dense[i * n + j] = dense[j * n + i] = sum;
+                largest = std::max(largest, std::abs(sum));
+            }
+        }
+        const double drop = n * std::numeric_limits<T>::epsilon() * largest;
+        for (size_t i = 0; i < n * n; ++i) {
+            if (std::abs(dense[i]) > drop) {
+                result.data.emplace(std::make_pair(i / n, i % n), static_cast<T>(dense[i]));
+            }
+        }
+        return result;
+    }
 
 public:
     SparseMatrix(size_t rows, size_t cols) : rows(rows), cols(cols) {}
 
     T& operator()(size_t row, size_t col) {
+        cachedStatistics.reset();
         return data[{row, col}];
     }
 
+    // Чтение без вставки: отсутствующий элемент считается нулём
+    T at(size_t row, size_t col) const {
+        auto it = data.find({ row, col });
+        return it == data.end() ? T(0) : it->second;
+    }
+
+    // Характеристики считаются при первом обращении и хранятся до следующей записи
+    const MatrixStatistics& statistics() const {
+        if (cachedStatistics) {
+            return *cachedStatistics;
+        }
+        MatrixStatistics stats;
+        std::vector<size_t> rowCount(rows);
+        std::vector<double> rowSum(rows), colSum(cols), diagonal(rows);
+        double frobenius = 0;
+        for (const auto& [key, value] : data) {
+            if (value == T(0)) {
+                continue;
+            }
+            double magnitude = std::abs(value);
+            ++stats.nonZeros;
+            ++rowCount[key.first];
+            rowSum[key.first] += magnitude;
+            colSum[key.second] += magnitude;
+            frobenius += magnitude * magnitude;
+            if (key.first == key.second) {
+                diagonal[key.first] = magnitude;
+            }
+            stats.bandwidth = std::max(stats.bandwidth, key.first > key.second ? key.first - key.second : key.second - key.first);
+            if (stats.symmetric && key.first != key.second && (key.second >= rows || at(key.second, key.first) != value)) {
+                stats.symmetric = false;
+            }
+        }
+        stats.symmetric = stats.symmetric && rows == cols;
+        stats.diagonallyDominant = rows == cols;
+        for (size_t row = 0; row < rows; ++row) {
+            size_t bucket = 0;
+            for (size_t count = rowCount[row]; count != 0; count >>= 1) {
+                ++bucket;
+            }
+            if (stats.rowHistogram.size() <= bucket) {
+                stats.rowHistogram.resize(bucket + 1);
+            }
+            ++stats.rowHistogram[bucket];
+            stats.maxRowNonZeros = std::max(stats.maxRowNonZeros, rowCount[row]);
+            if (!(rowSum[row] <= stats.normInf)) {
+                stats.normInf = rowSum[row]; // Сравнение без std::max, чтобы NaN не терялся
+            }
+            if (stats.diagonallyDominant && diagonal[row] <= rowSum[row] - diagonal[row]) {
+                stats.diagonallyDominant = false;
+            }
+        }
+        for (double sum : colSum) {
+            if (!(sum <= stats.norm1)) {
+                stats.norm1 = sum;
+            }
+        }
+        stats.frobenius = std::sqrt(frobenius);
+        cachedStatistics = std::move(stats);
+        return *cachedStatistics;
+    }
+
+    // Оценка ||A^power||_1 без вычисления степени
+    double normEstimate1(int power = 1) const {
+        if (rows != cols) {
+            throw std::invalid_argument("Matrix must be square to estimate norms of its powers.");
+        }
+        if (power == 1) {
+            return statistics().norm1;
+        }
+        auto apply = [this, power](bool transposed) {
+            return [this, power, transposed](const std::vector<T>& vec) {
+                std::vector<T> result = vec;
+                for (int i = 0; i < power; ++i) {
+                    result = multiplyDense(result, transposed);
+                }
+                return result;
+            };
+        };
+        return estimateNorm1(rows, apply(false), apply(true));
+    }
+
     // Оператор сравнения
     bool operator==(const SparseMatrix<T>& other) const {
         if (rows != other.rows || cols != other.cols) {
@@ -120,14 +890,18 @@ public:
             rows = other.rows;
             cols = other.cols;
             data = other.data; // Копируем данные
+            cachedStatistics = other.cachedStatistics;
         }
         return *this; // Возвращаем ссылку на текущий объект
     }
 
     SparseMatrix<T> operator+(const SparseMatrix<T>& other) const {
+        if (rows != other.rows || cols != other.cols) {
+            throw std::invalid_argument("Matrices must have the same dimensions for addition.");
+        }
         SparseMatrix<T> result(rows, cols);
         for (const auto& [key, value] : data) {
-            result(key.first, key.second) = value + other.data.at(key);
+            result(key.first, key.second) = value + other.at(key.first, key.second);
         }
         for (const auto& [key, value] : other.data) {
             if (data.find(key) == data.end()) {
@@ -147,7 +921,7 @@ public:
 
         // Вычитаем элементы
         for (const auto& [key, value] : data) {
-            result(key.first, key.second) = value - other.data.at(key);
+            result(key.first, key.second) = value - other.at(key.first, key.second);
         }
 
         // Обрабатываем элементы, которые есть только в другой матрице
@@ -188,6 +962,7 @@ public:
 
     // Функция для применения переданной функции к каждому элементу матрицы
     void applyFunction(const std::function<T(T)>& func) {
+        cachedStatistics.reset();
         for (auto& [key, value] : data) {
             value = func(value);
         }
@@ -201,10 +976,77 @@ public:
         return result;
     }
 
+    // Граф разреженности A + A^T без диагонали; списки соседей упорядочены
+    GraphOrdering::Adjacency adjacency() const {
+        if (rows != cols) {
+            throw std::invalid_argument("Matrix must be square to build its graph.");
+        }
+        GraphOrdering::Adjacency result(rows);
+        for (const auto& [key, value] : data) {
+            if (key.first != key.second && value != T(0)) {
+                result[key.first].push_back(key.second);
+                result[key.second].push_back(key.first);
+            }
+        }
+        for (auto& neighbours : result) {
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        }
+        return result;
+    }
+
+    std::vector<size_t> reverseCuthillMcKee() const {
+        return GraphOrdering(adjacency()).reverseCuthillMcKee();
+    }
+
+    std::vector<size_t> degreeOrdering() const {
+        return GraphOrdering(adjacency()).degreeOrdering();
+    }
+
+    std::vector<size_t> partitionOrdering(size_t blockSize = 256) const {
+        return GraphOrdering(adjacency()).partitionOrdering(blockSize);
+    }
+
+    // Симметричная перестановка P A P^T, perm[новый индекс] = старый индекс.
+    // Решение для переставленной системы возвращается к исходной нумерации через
+    // SparseVector::unpermute, обратная матрица - через permute(inversePermutation(perm))
+    SparseMatrix<T> permute(const std::vector<size_t>& perm) const {
+        if (rows != cols || perm.size() != rows) {
+            throw std::invalid_argument("Permutation size must match the square matrix size.");
+        }
+        std::vector<size_t> inverse = inversePermutation(perm);
+        SparseMatrix<T> result(rows, cols);
+        result.data.reserve(data.size());
+        for (const auto& [key, value] : data) {
+            result.data.emplace(std::make_pair(inverse[key.first], inverse[key.second]), value);
+        }
+        return result;
+    }
+
+    // Сохраняет матрицу в сжатый построчный файл для OutOfCoreMatrix
+    void saveCompressed(const std::string& path) const {
+        std::vector<std::vector<std::pair<size_t, T>>> byRow(rows);
+        for (const auto& [key, value] : data) {
+            if (value != T(0)) {
+                byRow[key.first].emplace_back(key.second, value);
+            }
+        }
+        CompressedMatrixWriter<T> writer(path, rows, cols);
+        for (auto& row : byRow) {
+            writer.appendRow(std::move(row));
+        }
+        writer.finish();
+    }
+
+    // Ширина ленты: наибольшее |i - j| среди ненулевых элементов
+    size_t bandwidth() const {
+        return statistics().bandwidth;
+    }
+
     SparseVector<T> operator*(const SparseVector<T>& vec) const {
         SparseVector<T> result(rows);
         for (const auto& [key, value] : data) {
-            result[key.first] += value * vec[key.second];
+            result[key.first] += value * vec.at(key.second);
         }
         return result;
     }
@@ -216,19 +1058,50 @@ public:
         }
 
         SparseMatrix<T> result(rows, other.cols);
+        const MatrixStatistics& left = statistics();
+        const MatrixStatistics& right = other.statistics();
+
+        // Диагональный множитель лишь масштабирует столбцы или строки другого
+        if (right.bandwidth == 0 || left.bandwidth == 0) {
+            const bool scaleColumns = right.bandwidth == 0;
+            const SparseMatrix<T>& scaled = scaleColumns ? *this : other;
+            const SparseMatrix<T>& diagonal = scaleColumns ? other : *this;
+            result.data.reserve(scaled.statistics().nonZeros);
+            for (const auto& [key, value] : scaled.data) {
+                size_t index = scaleColumns ? key.second : key.first;
+                T product = scaleColumns ? value * diagonal.at(index, index) : diagonal.at(index, index) * value;
+                if (product != T(0)) {
+                    result.data.emplace(key, product);
+                }
+            }
+            return result;
+        }
 
-        for (const auto& [key1, value1] : data) {
-            size_t row1 = key1.first;
-            size_t col1 = key1.second;
-
-            for (const auto& [key2, value2] : other.data) {
-                size_t row2 = key2.first;
-                size_t col2 = key2.second;
-
-                if (col1 == row2) {
-                    result(row1, col2) += value1 * value2;
+        // Общий случай: построчное умножение Густавсона с плотным аккумулятором строки
+        auto leftRows = rowLists();
+        auto rightRows = other.rowLists();
+        std::vector<T> accumulator(other.cols);
+        std::vector<bool> used(other.cols);
+        std::vector<size_t> touched;
+        result.data.reserve(left.nonZeros + right.nonZeros);
+        for (size_t row = 0; row < rows; ++row) {
+            for (const auto& [middle, a] : leftRows[row]) {
+                for (const auto& [col, b] : rightRows[middle]) {
+                    if (!used[col]) {
+                        used[col] = true;
+                        touched.push_back(col);
+                    }
+                    accumulator[col] += a * b;
+                }
+            }
+            for (size_t col : touched) {
+                if (accumulator[col] != T(0)) {
+                    result.data.emplace(std::make_pair(row, col), accumulator[col]);
                 }
+                accumulator[col] = 0;
+                used[col] = false;
             }
+            touched.clear();
         }
 
         return result;
@@ -259,6 +1132,22 @@ public:
             throw std::invalid_argument("Matrix must be square for inversion.");
         }
 
+        const MatrixStatistics& stats = statistics();
+        // Диагональная матрица обращается поэлементно
+        if (stats.bandwidth == 0) {
+            SparseMatrix<T> result(rows, cols);
+            for (size_t i = 0; i < rows; ++i) {
+                T divisor = at(i, i);
+                if (divisor == 0) {
+                    throw std::runtime_error("Matrix is singular and cannot be inverted.");
+                }
+                result(i, i) = T(1) / divisor;
+            }
+            return result;
+        }
+        // При строгом диагональном преобладании исключение устойчиво без выбора ведущего элемента
+        const bool pivoting = !stats.diagonallyDominant;
+
         SparseMatrix<T> result(rows, cols);
         // Инициализация единичной матрицы
         for (size_t i = 0; i < rows; ++i) {
@@ -269,7 +1158,7 @@ public:
         // Создание расширенной матрицы
         for (size_t i = 0; i < rows; ++i) {
             for (size_t j = 0; j < cols; ++j) {
-                augmented(i, j) = (*this)(i, j);
+                augmented(i, j) = at(i, j);
                 if (j == i) {
                     augmented(i, j + cols) = 1; // Добавление единичной матрицы
                 }
@@ -283,16 +1172,20 @@ public:
         for (size_t i = 0; i < rows; ++i) {
             // Поиск максимального элемента в столбце
             size_t maxRow = i;
-            for (size_t k = i + 1; k < rows; ++k) {
+            for (size_t k = i + 1; pivoting && k < rows; ++k) {
                 if (std::abs(augmented(k, i)) > std::abs(augmented(maxRow, i))) {
                     maxRow = k;
                 }
             }
             // Обмен текущей строки с максимальной
-            for (size_t k = 0; k < cols * 2; ++k) {
+            for (size_t k = 0; maxRow != i && k < cols * 2; ++k) {
                 std::swap(augmented(i, k), augmented(maxRow, k));
             }
 
+            if (augmented(i, i) == 0) {
+                throw std::runtime_error("Matrix is singular and cannot be inverted.");
+            }
+
             // Приведение к верхнетреугольному виду
             for (size_t k = i + 1; k < rows; ++k) {
                 T factor = augmented(k, i) / augmented(i, i);
@@ -330,84 +1223,377 @@ public:
     }   
 
 
+    // Вещественная степень. Целые p - через power_int (отрицательные - через обратную),
+    // диагональная матрица - поэлементно, симметричная - через собственное разложение
+    // V diag(lambda^p) V^T, остальные - как exp(p log A)
     SparseMatrix<T> power(double p, int approxOrder = 100)  {
         if (rows != cols) {
             throw std::invalid_argument("Matrix must be square to compute power.");
         }
 
+        if (p == std::floor(p) && std::abs(p) <= std::numeric_limits<int>::max()) {
+            int exponent = static_cast<int>(p);
+            return exponent >= 0 ? power_int(exponent) : inverse().power_int(-exponent);
+        }
+
+        const MatrixStatistics& stats = statistics();
+        if (stats.bandwidth == 0 || stats.symmetric) {
+            return spectralFunction([p](double lambda) {
+                if (!(lambda > 0)) {
+                    throw std::invalid_argument("Fractional power requires positive eigenvalues.");
+                }
+                return std::pow(lambda, p);
+            });
+        }
+
         SparseMatrix<T> logA = log(approxOrder);
-        SparseMatrix<T> pLogA = logA * p;
+        SparseMatrix<T> pLogA = logA * static_cast<T>(p);
 
         return pLogA.exp(approxOrder);
     }
 
+    // Главный квадратный корень итерацией Денмана-Биверса в форме произведения:
+    // M(k+1) = (I + (M(k) + M(k)^-1) / 2) / 2, Y(k+1) = Y(k) (I + M(k)^-1) / 2, M -> I, Y -> A^(1/2).
+    // Одно обращение на итерацию; сходится, если у A нет собственных значений на (-inf, 0]
+    SparseMatrix<T> squareRoot() const {
+        if (rows != cols) {
+            throw std::invalid_argument("Matrix must be square to compute the square root.");
+        }
+        const SparseMatrix<T> I = identity(rows);
+        SparseMatrix<T> M = *this;
+        SparseMatrix<T> Y = *this;
+        for (int iteration = 0; iteration < 64; ++iteration) {
+            double distance = (M - I).statistics().norm1;
+            if (!std::isfinite(distance)) {
+                break;
+            }
+            if (distance <= 8 * std::numeric_limits<T>::epsilon()) {
+                return Y;
+            }
+            SparseMatrix<T> MInverse(rows, cols);
+            try {
+                MInverse = M.inverse();
+            }
+            catch (const std::runtime_error&) {
+                break; // Вырожденная M(k) - признак собственного значения на отрицательной полуоси
+            }
+            Y = Y * (I + MInverse) / static_cast<T>(2);
+            M = (I + (M + MInverse) / static_cast<T>(2)) / static_cast<T>(2);
+        }
+        throw std::runtime_error("Square root iteration did not converge: the matrix may have eigenvalues on the closed negative real axis.");
+    }
+
+    // Обратное масштабирование и возведение в квадрат (Кенни-Лауб, Хайэм): квадратные корни
+    // извлекаются, пока ||A^(1/2^s) - I||_1 > 1/4, затем log(I + X) приближается диагональной
+    // аппроксимацией Паде r_m(X) = sum w_j X (I + x_j X)^-1 по узлам Гаусса-Лежандра на [0, 1],
+    // и log A = 2^s r_m(X). Степень m - наименьшая, при которой скалярная оценка ошибки
+    // |log(1 - theta) - r_m(-theta)| для theta = ||X||_1 не превышает машинной точности,
+    // но не больше approxOrder. Симметричная матрица логарифмируется через собственное разложение
     SparseMatrix<T> log(int approxOrder = 100)  {
         if (rows != cols) {
             throw std::invalid_argument("Matrix must be square to compute the logarithm.");
         }
 
-        SparseMatrix<T> I = SparseMatrix<T>(rows, cols);
-        for (size_t i = 0; i < rows; ++i) {
-            I(i, i) = 1; // Создание единичной матрицы
+        const MatrixStatistics& stats = statistics();
+        if (stats.bandwidth == 0 || stats.symmetric) {
+            return spectralFunction([](double lambda) {
+                if (!(lambda > 0)) {
+                    throw std::invalid_argument("Real logarithm requires positive eigenvalues.");
+                }
+                return std::log(lambda);
+            });
         }
 
-        if (*this == I) {
-            return SparseMatrix<T>(rows, cols); // Возвращаем нулевую матрицу
+        const SparseMatrix<T> I = identity(rows);
+        SparseMatrix<T> root = *this;
+        int roots = 0;
+        SparseMatrix<T> X = root - I;
+        double theta = X.statistics().norm1;
+        while (!(theta <= 0.25)) {
+            if (roots == 64) {
+                throw std::runtime_error("Inverse scaling did not bring the matrix close to the identity.");
+            }
+            root = root.squareRoot();
+            ++roots;
+            X = root - I;
+            theta = X.statistics().norm1;
         }
-
-        if (frobeniusNorm(*this) >= 1) {
-            throw std::invalid_argument("Frobenius matrix norm must be less than 1.");
+        if (theta == 0) {
+            return SparseMatrix<T>(rows, cols);
         }
 
-        SparseMatrix<T> A_minus_I = *this - I;
-        SparseMatrix<T> result(rows, cols);
-        SparseMatrix<T> term = A_minus_I;
-
-        for (int n = 1; n <= approxOrder; ++n) {
-            if (n > 1) {
-                term = term * A_minus_I;
+        std::vector<double> nodes, weights;
+        const double tolerance = std::numeric_limits<double>::epsilon();
+        int degree = 1;
+        for (; degree < std::max(1, approxOrder); ++degree) {
+            gaussLegendre(degree, nodes, weights);
+            double pade = 0;
+            for (int j = 0; j < degree; ++j) {
+                pade += weights[j] * -theta / (1 - nodes[j] * theta);
             }
-            if (n % 2 == 0) {
-                result = result - term / static_cast<T>(n);
-            }
-            else {
-                result = result + term / static_cast<T>(n);
+            if (std::abs(std::log1p(-theta) - pade) <= tolerance * std::abs(std::log1p(-theta))) {
+                break;
             }
         }
+        gaussLegendre(degree, nodes, weights);
 
-        return result;
+        SparseMatrix<T> result(rows, cols);
+        for (int j = 0; j < degree; ++j) {
+            SparseMatrix<T> shifted = I + X * static_cast<T>(nodes[j]);
+            result = result + X * shifted.inverse() * static_cast<T>(weights[j]);
+        }
+
+        return roots == 0 ? result : result * static_cast<T>(std::ldexp(1.0, roots));
     }
 
-    double frobeniusNorm(const SparseMatrix<T>& matrix)  {
-        double norm = 0.0;
-        for (const auto& [key, value] : matrix.data) {
-            norm += std::pow(std::abs(value), 2);
-        }
-        return std::sqrt(norm);
+    double frobeniusNorm(const SparseMatrix<T>& matrix) const {
+        return matrix.statistics().frobenius;
     }
 
+    // Масштабирование и возведение в квадрат: exp(A) = exp(A / 2^s)^(2^s), где s выбрано так,
+    // чтобы оценка нормы A / 2^s не превышала 1/2, а число членов ряда Тейлора - по оценке
+    // остатка theta^(m+1) / (m+1)! * e^theta. Для оценки нормы берётся меньшая из ||A||_1 и
+    // max(||A^2||^(1/2), ||A^3||^(1/3)) (Аль-Мохи и Хайэм), которая для ненормальных матриц
+    // бывает намного меньше ||A||_1 и экономит возведения в квадрат
     SparseMatrix<T> exp(int approxOrder = 100)  {
         if (rows != cols) {
             throw std::invalid_argument("Matrix must be square to compute the exponential.");
         }
 
-        SparseMatrix<T> result(rows, cols);
-        for (size_t i = 0; i < rows; ++i) {
-            result(i, i) = 1; // Создание единичной матрицы
+        const MatrixStatistics& stats = statistics();
+        if (stats.bandwidth == 0) {
+            SparseMatrix<T> result(rows, cols);
+            for (size_t i = 0; i < rows; ++i) {
+                result(i, i) = std::exp(at(i, i));
+            }
+            return result;
+        }
+
+        double theta = std::min(stats.norm1, std::max(std::sqrt(normEstimate1(2)), std::cbrt(normEstimate1(3))));
+        int squarings = 0;
+        while (theta > 0.5 && squarings < 64) {
+            theta /= 2;
+            ++squarings;
         }
 
-        SparseMatrix<T> term = *this;
+        const double tolerance = std::numeric_limits<double>::epsilon() / 2;
+        int terms = 1;
+        for (double remainder = theta * theta / 2 * std::exp(theta); remainder > tolerance && terms < approxOrder; ++terms) {
+            remainder *= theta / (terms + 2);
+        }
+
+        SparseMatrix<T> scaled = squarings == 0 ? *this : *this / static_cast<T>(std::ldexp(1.0, squarings));
+        SparseMatrix<T> result = identity(rows);
+        SparseMatrix<T> term = scaled;
         result = result + term;
 
-        for (size_t n = 2; n < approxOrder; ++n) {
-            term = term * *this;
+        for (int n = 2; n <= terms; ++n) {
+            term = term * scaled;
             term = term / static_cast<T>(n);
             result = result + term;
         }
 
+        for (int i = 0; i < squarings; ++i) {
+            result = result * result;
+        }
+
+        return result;
+    }
+
+};
+
+// Матрица в сжатом файле, не загружаемая в память целиком. Умножения проходят по
+// блокам строк: пока обрабатывается текущий блок, следующий асинхронно подкачивается
+// с диска, а обработанный выгружается. Бюджет памяти ограничивает два блока в работе;
+// плотные векторы-операнды и результат в него не входят и должны помещаться в память.
+template<typename T>
+class OutOfCoreMatrix {
+public:
+    struct Options {
+        size_t memoryBudget = size_t(256) << 20; // Байт отображённой матрицы одновременно в памяти
+    };
+
+    struct EigenResult {
+        T value;
+        std::vector<T> vector;
+        int iterations;
+    };
+
+    explicit OutOfCoreMatrix(const std::string& path) : OutOfCoreMatrix(path, Options()) {}
+
+    OutOfCoreMatrix(const std::string& path, Options options) : file(path) {
+        if (file.size() < sizeof(MatrixFileHeader)) {
+            throw std::runtime_error("Matrix file is truncated: " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, matrixFileMagic, sizeof(header.magic)) != 0 || header.version != matrixFileVersion) {
+            throw std::runtime_error("Not a matrix file: " + path);
+        }
+        if (header.valueSize != sizeof(T)) {
+            throw std::runtime_error("Matrix file value size does not match the element type: " + path);
+        }
+        // Размеры сравниваются делением, чтобы повреждённые счётчики не переполнили умножение
+        if (header.nonZeros > (file.size() - sizeof(MatrixFileHeader)) / sizeof(MatrixEntry<T>)) {
+            throw std::runtime_error("Matrix file is truncated: " + path);
+        }
+        uint64_t tableOffset = sizeof(MatrixFileHeader) + header.nonZeros * sizeof(MatrixEntry<T>);
+        if (header.rows >= (file.size() - tableOffset) / sizeof(uint64_t)) {
+            throw std::runtime_error("Matrix file is truncated: " + path);
+        }
+        entries = reinterpret_cast<const MatrixEntry<T>*>(file.data() + sizeof(MatrixFileHeader));
+        rowOffsets = reinterpret_cast<const uint64_t*>(file.data() + tableOffset);
+        if (rowOffsets[0] != 0 || rowOffsets[header.rows] != header.nonZeros) {
+            throw std::runtime_error("Matrix file has a corrupted row table: " + path);
+        }
+
+        // Блоки строк по половине бюджета; строка, не помещающаяся целиком, образует свой блок
+        size_t blockEntries = std::max<size_t>(1, options.memoryBudget / 2 / sizeof(MatrixEntry<T>));
+        blockRows.push_back(0);
+        for (size_t row = 0; row < header.rows; ++row) {
+            if (rowOffsets[row] > rowOffsets[row + 1] || rowOffsets[row + 1] > header.nonZeros) {
+                throw std::runtime_error("Matrix file has a corrupted row table: " + path);
+            }
+            if (rowOffsets[row + 1] - rowOffsets[blockRows.back()] > blockEntries && row > blockRows.back()) {
+                blockRows.push_back(row);
+            }
+        }
+        blockRows.push_back(header.rows);
+    }
+
+    size_t getRows() const {
+        return header.rows;
+    }
+
+    size_t getCols() const {
+        return header.cols;
+    }
+
+    size_t nonZeros() const {
+        return header.nonZeros;
+    }
+
+    size_t blockCount() const {
+        return blockRows.size() - 1;
+    }
+
+    std::vector<T> operator*(const std::vector<T>& vec) const {
+        if (vec.size() != header.cols) {
+            throw std::invalid_argument("Vector size must match the number of columns.");
+        }
+        std::vector<T> result(header.rows);
+        forEachBlock([&](size_t rowBegin, size_t rowEnd) {
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                T sum = 0;
+                for (uint64_t e = rowOffsets[row]; e < rowOffsets[row + 1]; ++e) {
+                    sum += entries[e].value * vec[column(e)];
+                }
+                result[row] = sum;
+            }
+        });
+        return result;
+    }
+
+    // Умножение на высокую узкую плотную матрицу cols x width, хранимую по строкам;
+    // результат rows x width. Каждый элемент матрицы читается с диска один раз на все width столбцов
+    std::vector<T> multiply(const std::vector<T>& dense, size_t width) const {
+        if (width == 0 || dense.size() != header.cols * width) {
+            throw std::invalid_argument("Dense operand must have cols x width elements.");
+        }
+        std::vector<T> result(header.rows * width);
+        forEachBlock([&](size_t rowBegin, size_t rowEnd) {
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                T* out = result.data() + row * width;
+                for (uint64_t e = rowOffsets[row]; e < rowOffsets[row + 1]; ++e) {
+                    const T value = entries[e].value;
+                    const T* in = dense.data() + column(e) * width;
+                    for (size_t k = 0; k < width; ++k) {
+                        out[k] += value * in[k];
+                    }
+                }
+            }
+        });
         return result;
     }
 
+    // Степенной метод: наибольшее по модулю собственное значение и его вектор
+    EigenResult powerIteration(int maxIterations = 1000, double tolerance = 1e-10) const {
+        if (header.rows != header.cols) {
+            throw std::invalid_argument("Matrix must be square for power iteration.");
+        }
+        // Начальный вектор без симметрий, иначе он может оказаться ортогонален искомому
+        EigenResult eigen{ T(0), std::vector<T>(header.rows), 0 };
+        T startNorm = 0;
+        for (size_t i = 0; i < header.rows; ++i) {
+            eigen.vector[i] = static_cast<T>(1 + (i * 2654435761u) % 1000 / 1000.0);
+            startNorm += eigen.vector[i] * eigen.vector[i];
+        }
+        for (T& value : eigen.vector) {
+            value /= std::sqrt(startNorm);
+        }
+        while (eigen.iterations < maxIterations) {
+            ++eigen.iterations;
+            std::vector<T> next = *this * eigen.vector;
+            T rayleigh = 0, norm = 0;
+            for (size_t i = 0; i < next.size(); ++i) {
+                rayleigh += eigen.vector[i] * next[i];
+                norm += next[i] * next[i];
+            }
+            norm = std::sqrt(norm);
+            if (norm == 0) {
+                eigen.value = 0;
+                break;
+            }
+            for (T& value : next) {
+                value /= norm;
+            }
+            eigen.vector = std::move(next);
+            bool converged = std::abs(rayleigh - eigen.value) <= tolerance * std::abs(rayleigh);
+            eigen.value = rayleigh;
+            if (converged) {
+                break;
+            }
+        }
+        return eigen;
+    }
+
+private:
+    MappedFile file;
+    MatrixFileHeader header{};
+    const MatrixEntry<T>* entries = nullptr;
+    const uint64_t* rowOffsets = nullptr;
+    std::vector<size_t> blockRows; // Первая строка каждого блока и число строк в конце
+
+    size_t column(uint64_t entry) const {
+        size_t col = static_cast<size_t>(entries[entry].col);
+        if (col >= header.cols) {
+            throw std::runtime_error("Matrix file has a column index out of range.");
+        }
+        return col;
+    }
+
+    size_t blockOffset(size_t block) const {
+        return sizeof(MatrixFileHeader) + rowOffsets[blockRows[block]] * sizeof(MatrixEntry<T>);
+    }
+
+    size_t blockBytes(size_t block) const {
+        return (rowOffsets[blockRows[block + 1]] - rowOffsets[blockRows[block]]) * sizeof(MatrixEntry<T>);
+    }
+
+    // Вызывает compute(rowBegin, rowEnd) для блоков по порядку, подкачивая следующий блок параллельно
+    template<typename Compute>
+    void forEachBlock(Compute compute) const {
+        std::future<void> readAhead = std::async(std::launch::async, [this] { file.prefetch(blockOffset(0), blockBytes(0)); });
+        for (size_t block = 0; block < blockCount(); ++block) {
+            readAhead.get();
+            if (block + 1 < blockCount()) {
+                readAhead = std::async(std::launch::async, [this, block] {
+                    file.prefetch(blockOffset(block + 1), blockBytes(block + 1));
+                });
+            }
+            compute(blockRows[block], blockRows[block + 1]);
+            file.release(blockOffset(block), blockBytes(block));
+        }
+    }
 };
 
 // Хеш-функция для пар
@@ -441,6 +1627,7 @@ int main()
     mat(2, 2) = 3;
 
     std::cout << "Matrix:\n" << mat << "\n";
+    std::cout << "Statistics: " << mat.statistics() << "\n\n";
 
     SparseMatrix<double> result = mat.power_int(2);
     std::cout << "Matrix raised to the power of 2:\n" << result << "\n";
@@ -451,7 +1638,71 @@ int main()
 
     std::cout << "Inverse Mat:\n" << mat.inverse() << "\n";
 
-    //std::cout << "Matrix raised to the power of 2:\n" << mat.power(2.0) << "\n";
+    std::cout << "Matrix raised to the power of 2:\n" << mat.power(2.0) << "\n";
+
+    // Дробные степени: симметричная матрица - через собственное разложение,
+    // несимметричная - через логарифм обратным масштабированием и возведением в квадрат
+    SparseMatrix<double> spd(3, 3), upper(3, 3);
+    spd(0, 0) = 4; spd(0, 1) = spd(1, 0) = 1; spd(1, 1) = 3; spd(2, 2) = 2;
+    upper(0, 0) = 9; upper(0, 1) = 2; upper(1, 1) = 4; upper(1, 2) = 5; upper(2, 2) = 1;
+    for (SparseMatrix<double>* m : { &spd, &upper }) {
+        SparseMatrix<double> root = m->power(0.5);
+        SparseMatrix<double> residual = root * root - *m;
+        std::cout << "Square root residual: " << residual.statistics().norm1 << "\n";
+    }
+
+    // Перенумерация сетки 8x8, узлы которой пронумерованы вразброс
+    const size_t side = 8, n = side * side;
+    std::vector<size_t> scatter(n);
+    for (size_t i = 0; i < n; ++i) {
+        scatter[i] = (i * 37) % n;
+    }
+    SparseMatrix<double> grid(n, n);
+    SparseVector<double> x(n);
+    for (size_t r = 0; r < side; ++r) {
+        for (size_t c = 0; c < side; ++c) {
+            size_t node = scatter[r * side + c];
+            grid(node, node) = 4;
+            if (c + 1 < side) {
+                grid(node, scatter[r * side + c + 1]) = grid(scatter[r * side + c + 1], node) = -1;
+            }
+            if (r + 1 < side) {
+                grid(node, scatter[(r + 1) * side + c]) = grid(scatter[(r + 1) * side + c], node) = -1;
+            }
+            x[node] = static_cast<double>(node);
+        }
+    }
+    std::vector<size_t> order = grid.reverseCuthillMcKee();
+    SparseMatrix<double> reordered = grid.permute(order);
+    std::cout << "Bandwidth: " << grid.bandwidth() << ", after RCM: " << reordered.bandwidth() << "\n";
+    SparseVector<double> y = (reordered * x.permute(order)).unpermute(order);
+    SparseVector<double> expected = grid * x;
+    double error = 0;
+    for (size_t i = 0; i < n; ++i) {
+        error = std::max(error, std::abs(y.at(i) - expected.at(i)));
+    }
+    std::cout << "Reordered SpMV error: " << error << "\n";
+
+    // Та же матрица из файла, блоками по 256 байт
+    reordered.saveCompressed("grid.csr");
+    {
+        OutOfCoreMatrix<double>::Options options;
+        options.memoryBudget = 512;
+        OutOfCoreMatrix<double> onDisk("grid.csr", options);
+        std::vector<double> dense(n);
+        for (size_t i = 0; i < n; ++i) {
+            dense[i] = x.permute(order).at(i);
+        }
+        std::vector<double> streamed = onDisk * dense;
+        double streamError = 0;
+        for (size_t i = 0; i < n; ++i) {
+            streamError = std::max(streamError, std::abs(streamed[i] - y.at(order[i])));
+        }
+        auto eigen = onDisk.powerIteration();
+        std::cout << "Out-of-core SpMV error: " << streamError << " (" << onDisk.blockCount() << " blocks)"
+            << ", dominant eigenvalue: " << eigen.value << " after " << eigen.iterations << " iterations\n";
+    }
+    std::remove("grid.csr");
 
     return 0;
 }